@@ -0,0 +1,73 @@
+/*---------------------------------------------------------------------------/
+/  Configurations of FatFs Module, used by the trace logger (trace_log.c)
+/  to create its file on a USB stick.  Trace data bypasses FatFs and is
+/  written straight to the preallocated sectors, so only what creating a
+/  contiguous file needs is enabled.
+/---------------------------------------------------------------------------*/
+
+#define FFCONF_DEF	80286	/* Revision ID */
+
+/*---------------------------------------------------------------------------/
+/ Function Configurations
+/---------------------------------------------------------------------------*/
+
+#define FF_FS_READONLY	0
+#define FF_FS_MINIMIZE	0
+#define FF_USE_FIND		0
+#define FF_USE_MKFS		0
+#define FF_USE_FASTSEEK	0
+#define FF_USE_EXPAND	1		/* f_expand(), contiguous preallocation */
+#define FF_USE_CHMOD	0
+#define FF_USE_LABEL	0
+#define FF_USE_FORWARD	0
+#define FF_USE_STRFUNC	0
+#define FF_PRINT_LLI	0
+#define FF_PRINT_FLOAT	0
+#define FF_STRF_ENCODE	0
+
+
+/*---------------------------------------------------------------------------/
+/ Locale and Namespace Configurations
+/---------------------------------------------------------------------------*/
+
+#define FF_CODE_PAGE	437
+#define FF_USE_LFN		0		/* trace files have 8.3 names */
+#define FF_MAX_LFN		255
+#define FF_LFN_UNICODE	0
+#define FF_LFN_BUF		255
+#define FF_SFN_BUF		12
+#define FF_FS_RPATH		0
+
+
+/*---------------------------------------------------------------------------/
+/ Drive/Volume Configurations
+/---------------------------------------------------------------------------*/
+
+#define FF_VOLUMES		1
+#define FF_STR_VOLUME_ID	0
+#define FF_VOLUME_STRS		"USB"
+#define FF_MULTI_PARTITION	0
+#define FF_MIN_SS		512
+#define FF_MAX_SS		512		/* trace blocks are written in 512 byte sectors */
+#define FF_LBA64		0
+#define FF_MIN_GPT		0x10000000
+#define FF_USE_TRIM		0
+
+
+/*---------------------------------------------------------------------------/
+/ System Configurations
+/---------------------------------------------------------------------------*/
+
+#define FF_FS_TINY		1
+#define FF_FS_EXFAT		0
+#define FF_FS_NORTC		1		/* no calendar clock */
+#define FF_NORTC_MON	1
+#define FF_NORTC_MDAY	1
+#define FF_NORTC_YEAR	2024
+#define FF_FS_NOFSINFO	0
+#define FF_FS_LOCK		0
+#define FF_FS_REENTRANT	0
+#define FF_FS_TIMEOUT	1000
+#define FF_SYNC_t		HANDLE
+
+/*--- End of configuration options ---*/
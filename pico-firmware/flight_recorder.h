@@ -0,0 +1,49 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+// Flight recorder event format, shared between the firmware and the
+// rt-flight host tool.  A dump on the debug UART has one line per event:
+//
+//   FR <time_us, 8 hex digits> <type, 2 hex digits> <data, hex>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One recorded event, 12 bytes in RAM
+struct FlightEvent {
+    uint32_t time_us;
+    uint8_t type;    // FR_EVENT_*
+    uint8_t len;     // bytes used in data
+    uint8_t data[6];
+};
+
+// Event types and their data
+#define FR_EVENT_USB_REPORT 0x01  // mouse slot, buttons, x, y
+#define FR_EVENT_RT_RX 0x02       // byte received from the RT
+#define FR_EVENT_RT_TX 0x03       // packet queued for the RT
+#define FR_EVENT_LINE_ERROR 0x04  // UARTDR error bits >> 8, received byte
+#define FR_EVENT_USB_ATTACH 0x05  // mouse slot, dev_addr, instance
+#define FR_EVENT_USB_DETACH 0x06  // mouse slot, dev_addr, instance
+#define FR_EVENT_TRIGGER 0x07     // FR_TRIGGER_*
+#define FR_EVENT_PACER 0x08       // data report sent: newest and oldest USB data age
+                                  // (us, u16 le, saturated), TX ring bytes, motion
+                                  // carried over (|dx| + |dy|, saturated)
+#define FR_EVENT_DROPPED 0x09     // telemetry only: events lost before this one (u16 le)
+
+// Reasons for a dump
+#define FR_TRIGGER_REQUEST 0      // requested on the debug console
+#define FR_TRIGGER_STALL 1        // motion pending but no report sent
+#define FR_TRIGGER_OVERRUN 2      // UART1 receive overrun, a command byte was lost
+#define FR_TRIGGER_RESET_STORM 3  // RESET commands in quick succession
+#define FR_TRIGGERS 4
+
+#define FR_TRIGGER_NAMES { "request", "stall", "overrun", "reset storm" }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLIGHT_RECORDER_H
@@ -4,10 +4,21 @@
 #include <tusb.h>
 #include <hardware/uart.h>
 #include <hardware/gpio.h>
+#include <hardware/irq.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
+#include <hardware/clocks.h>
+#include <hardware/structs/usb.h>
+#include <hardware/structs/systick.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>  // for abs()
 
+#include "rt_engine.h"
+#include "flight_recorder.h"
+#include "telemetry.h"
+#include "trace_log.h"
+
 // UART1 configuration for RT mouse protocol
 #define RT_UART_ID uart1
 #define RT_UART_TX_PIN 8
@@ -16,57 +27,408 @@
 #define RT_UART_DATA_BITS 8
 #define RT_UART_STOP_BITS 1
 #define RT_UART_PARITY UART_PARITY_ODD
+#define RT_UART_IRQ UART1_IRQ
+
+// Auto-baud: measure the bit width of incoming commands on the RX pin and
+// follow the RT when it runs the mouse line faster (or slower) than
+// RT_UART_BAUD.  Can also be toggled with 'b' on the debug console.
+// With RT_AUTOBAUD_SCALE_RATE the report rate set by the RT is scaled up
+// by the same factor as the line speed.
+#ifndef RT_AUTOBAUD
+#define RT_AUTOBAUD 0
+#endif
+#ifndef RT_AUTOBAUD_SCALE_RATE
+#define RT_AUTOBAUD_SCALE_RATE 1
+#endif
+#define RT_AUTOBAUD_MIN_BIT_US 30      // shorter pulses are glitches
+#define RT_AUTOBAUD_IDLE_US 20000      // line idle this long starts a new burst
+#define RT_AUTOBAUD_TOLERANCE_PCT 12
+
+// Size of the RT transmit ring, must be a power of two.  Data reports
+// are only queued while at least RT_TX_RESERVE bytes stay free so that
+// the RX interrupt can always answer a command.
+#define RT_TX_RING_SIZE 64
+#define RT_TX_RESERVE 8
+
+// Size of the debug log ring that carries RT line traffic from the
+// interrupt handler to the main loop for printing, power of two.
+#define RT_LOG_RING_SIZE 32
+
+// Number of USB mouse interfaces tracked at the same time
+#define MAX_USB_MICE 8
+
+// Bounds of the (dev_addr, instance) lookup map.  TinyUSB hands out
+// device addresses up to CFG_TUH_DEVICE_MAX + CFG_TUH_HUB.
+#define USB_MAX_DEV_ADDR (CFG_TUH_DEVICE_MAX + CFG_TUH_HUB + 1)
+#define USB_MAX_HID_INSTANCE 4
+
+// Motion scale applied to each USB mouse, 8.8 fixed point
+#define USB_MOUSE_SCALE_Q8 256
+
+// Interrupt endpoint poll interval forced on USB mice, in frames (ms).
+// Low-speed devices are specified for 10 ms or more and are only sped
+// up if USB_POLL_OVERRIDE_LOW_SPEED is set.  0 keeps bInterval.
+#define USB_POLL_INTERVAL_MS 1
+#define USB_POLL_OVERRIDE_LOW_SPEED 0
+
+// A data report that is due is held back for a fresher USB report if
+// one is expected within the device's poll interval plus this slack,
+// and the newest motion is older than RT_FRESH_DATA_US.
+#define RT_PHASE_LOCK_SLACK_US 200
+#define RT_FRESH_DATA_US 150
+
+// Motion retention: the RT driver wraps every status query and READXY
+// in DISABLE ... ENABLE.  USB motion and button presses during such a
+// window are kept and sent after ENABLE instead of being dropped.  A
+// window longer than RT_RETAIN_MAX_US is taken as a real disable and
+// what was kept is dropped.  Toggled with 'd' on the debug console.
+#ifndef RT_RETAIN_MOTION
+#define RT_RETAIN_MOTION 1
+#endif
+#ifndef RT_RETAIN_MAX_US
+#define RT_RETAIN_MAX_US 100000
+#endif
+
+// Loopback test: number of bytes sent and how long to wait for each one
+#define RT_LOOPBACK_BYTES 64
+#define RT_LOOPBACK_TIMEOUT_US 20000
+
+// Synthetic motion generator for bench and soak tests without a USB
+// mouse.  RT_SYNTH selects the pattern at boot (0 = off, see enum
+// SynthPattern), 'g', 'r' and 'a' change pattern, rate and amplitude
+// on the debug console.  The same seed gives the same motion.
+#ifndef RT_SYNTH
+#define RT_SYNTH 0
+#endif
+#ifndef RT_SYNTH_RATE_HZ
+#define RT_SYNTH_RATE_HZ 1000
+#endif
+#ifndef RT_SYNTH_AMPLITUDE
+#define RT_SYNTH_AMPLITUDE 8          // counts per report, 1 to 127
+#endif
+#ifndef RT_SYNTH_SEED
+#define RT_SYNTH_SEED 1
+#endif
+#define RT_SYNTH_SWIPE_REPORTS 64      // reports per swipe before reversing
+#define RT_SYNTH_MIX_PHASE_MS 2000     // time per pattern in the mix
+#define RT_SYNTH_DEV_ADDR 0            // never used by an enumerated device
+
+// Flight recorder: the last RT_FR_EVENTS USB reports, RT bytes received
+// and packets sent are kept in RAM and dumped on the debug UART with 'f'
+// or, with RT_FR_AUTO_DUMP, RT_FR_POST_TRIGGER_US after an anomaly.
+// Automatic dumps are at least RT_FR_HOLDOFF_US apart.  The ring holds
+// about 1.4 s of one 1 kHz mouse plus the RT traffic, so a stall dump
+// still starts before the motion that stalled.
+#define RT_FR_EVENTS 2048              // must be a power of two
+#ifndef RT_FR_AUTO_DUMP
+#define RT_FR_AUTO_DUMP 1
+#endif
+#define RT_FR_POST_TRIGGER_US 100000
+#define RT_FR_HOLDOFF_US 10000000
+#define RT_FR_STALL_US 500000          // motion pending this long without a report
+#define RT_FR_RESET_STORM 4            // RESET commands within RT_FR_RESET_STORM_US
+#define RT_FR_RESET_STORM_US 1000000
+#if RT_FR_EVENTS & (RT_FR_EVENTS - 1)
+#error RT_FR_EVENTS must be a power of two
+#endif
+#if RT_FR_EVENTS < (RT_FR_STALL_US + RT_FR_POST_TRIGGER_US) / 1000
+#error RT_FR_EVENTS is too small to hold a stall dump at 1 kHz
+#endif
+
+// Telemetry: every flight recorder event is also streamed in binary
+// (telemetry.h) to a USB-serial adapter on the hub, at the line speed
+// of CFG_TUH_CDC_LINE_CODING_ON_ENUM in tusb_config.h.  Interrupt
+// handlers only copy events into a ring, the main loop encodes and
+// writes them.  Events that do not fit in the ring are counted and
+// reported in the stream instead of waiting for the adapter.
+#ifndef RT_TELEMETRY
+#define RT_TELEMETRY 1
+#endif
+#define RT_TM_EVENTS 256               // must be a power of two
+#define RT_TM_EVENTS_PER_POLL 16       // bounds the time spent per main loop iteration
+
+// Samples of a duration, in system clock cycles or microseconds.  For
+// execution times the spread between min and max is the jitter added.
+struct TimingStats {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+};
+
+// Debug statistics, all times in microseconds since reset
+struct DebugStats {
+    uint32_t boot_main_us;           // main() entered
+    uint32_t boot_rt_ready_us;       // RT UART and responder up
+    uint32_t boot_usb_ready_us;      // USB host stack initialized
+    uint32_t boot_first_cmd_us;      // first command byte received from the RT
+    uint32_t boot_first_response_us; // first response queued to the RT
+    uint32_t rx_bytes;
+    uint32_t tx_bytes;
+    uint32_t log_overflows;
+    uint32_t usb_attaches;          // mouse interfaces mounted
+    uint32_t usb_detaches;          // mouse interfaces unmounted
+    uint32_t usb_untracked_reports; // reports from interfaces not in the table, dropped
+    uint32_t root_attach_us;        // device connected to the root port
+    uint32_t plug_to_report_us;     // root attach (or mount) to first motion report, last plug
+    uint32_t plug_to_report_max_us;
+    uint32_t buttons_released;      // packets sent to release buttons on detach
+    uint32_t short_presses;         // button changes undone before a report carried them
+    struct TimingStats rx_irq_cycles;  // RX interrupt, command byte to response queued
+    struct TimingStats report_cycles;  // pacer, encoding and queueing a data report
+    uint32_t loop_max_us;              // longest main loop iteration
+    struct TimingStats data_age_us;    // newest USB report in a packet to packet queued
+    struct TimingStats oldest_age_us;  // oldest USB report in a packet to packet queued
+    uint32_t phase_lock_holds;         // due reports held for a fresher USB report
+    uint32_t poll_overrides;           // interrupt endpoints sped up
+    struct TimingStats loopback_rtt_ns;   // byte written to UART to byte received
+    struct TimingStats loopback_wire_ns;  // round trip minus the character time
+    uint32_t loopback_lost;
+    uint32_t loopback_errors;          // wrong byte received
+    uint32_t autobaud_switches;
+    uint32_t autobaud_failures;        // bit width did not match any rate
+    uint32_t autobaud_bit_us;          // last measured bit width
+    uint32_t framing_errors;
+    uint32_t parity_errors;
+    uint32_t break_errors;
+    uint32_t overrun_errors;
+    uint32_t rt_resets;                // RESET commands received
+};
+
+static struct DebugStats debug_stats;
+
+// Per-interface state of attached USB mice.  The RT-side MouseState is
+// deliberately kept separate so that rate, resolution, scaling and mode
+// survive when a mouse is unplugged and another one is enumerated.
+// Buttons and the fractional part of scaled motion are kept per
+// interface and merged into pending_motion.
+struct UsbMouse {
+    bool attached;
+    uint8_t dev_addr;
+    uint8_t instance;
+    uint8_t buttons;
+    int16_t scale_q8;
+    int16_t frac_x;
+    int16_t frac_y;
+    uint32_t mount_us;
+    uint32_t first_report_us;
+    uint32_t last_report_us;
+    uint32_t report_interval_us;  // smoothed time between reports
+    uint32_t reports;
+};
+
+static struct UsbMouse usb_mice[MAX_USB_MICE];
+
+// Index into usb_mice plus one for every (dev_addr, instance), so that
+// finding the state of a report's sender does not depend on the number
+// of attached mice
+static uint8_t usb_mouse_map[USB_MAX_DEV_ADDR][USB_MAX_HID_INSTANCE];
+
+// Motion accumulated from USB reports until the pacer sends it to the RT
+struct PendingMotion {
+    int32_t dx;
+    int32_t dy;
+    uint8_t buttons;
+    uint8_t sent_buttons;         // buttons of the last packet
+    uint8_t pressed;              // pressed since the last packet, even if released again
+    uint8_t released;             // released since the last packet, even if pressed again
+    bool dirty;
+    uint32_t last_sent_us;
+    uint32_t oldest_report_us;    // first report since the last packet
+    uint32_t newest_report_us;
+    uint32_t report_interval_us;  // poll interval of the newest report's sender
+    bool phase_lock_holding;
+};
+
+static struct PendingMotion pending_motion;
+
+// Hold due reports for a fresher USB report, toggled with 'p'
+static bool rt_phase_lock = true;
+
+// Line speeds the RT keyboard adapter's mouse UART can be set to, see
+// msbaudtbl and the UART_B* counter values in mousereg.h.  The bit
+// widths and divisors are computed by init_rt_uart(), so that auto-baud
+// can switch rates from the RX interrupt without dividing or calling
+// into flash.  Not const, the table is read by that interrupt and has to
+// be in SRAM.
+struct RtUartRate {
+    uint32_t baud;
+    uint16_t bit_us;
+    uint16_t tolerance_us;
+    uint16_t ibrd;
+    uint8_t fbrd;
+};
+
+static struct RtUartRate rt_uart_rates[] = {
+    { .baud = 24000 }, { .baud = 19200 }, { .baud = 9600 },
+    { .baud = 4800 }, { .baud = 2400 }, { .baud = 1200 },
+};
+
+// Current RT line speed
+static uint32_t rt_uart_baud = RT_UART_BAUD;
+
+// Auto-baud state, the shortest pulse seen on the RX pin during the
+// current burst of line activity is taken as one bit
+struct AutoBaud {
+    volatile bool enabled;
+    uint32_t last_edge_us;
+    volatile uint32_t min_edge_us;
+};
+
+static struct AutoBaud autobaud = {
+    .enabled = RT_AUTOBAUD,
+    .min_edge_us = UINT32_MAX,
+};
+
+// Adapter-initiated loopback test, see run_loopback_test().  While it is
+// active, received bytes are timestamped instead of being handled as
+// commands.
+struct LoopbackTest {
+    volatile bool active;
+    volatile bool received;
+    volatile uint8_t rx_byte;
+    volatile uint32_t rx_cycles;
+};
+
+static struct LoopbackTest loopback_test;
+
+// Synthetic motion patterns
+enum SynthPattern {
+    SYNTH_OFF,
+    SYNTH_CIRCLE,   // constant speed circle
+    SYNTH_SWIPE,    // full-scale motion back and forth
+    SYNTH_JITTER,   // random motion within the amplitude
+    SYNTH_BUTTONS,  // random buttons on every report, no motion
+    SYNTH_IDLE,     // attached but no reports
+    SYNTH_MIX,      // all of the above in turn
+    SYNTH_PATTERNS
+};
+
+_Static_assert(RT_SYNTH >= 0 && RT_SYNTH < SYNTH_PATTERNS, "RT_SYNTH is not a synthetic motion pattern");
+
+static const char *const synth_pattern_names[SYNTH_PATTERNS] = {
+    "off", "circle", "swipe", "jitter", "buttons", "idle", "mix"
+};
+
+// Synthetic motion generator state.  Reports go through the same path
+// as those of a real mouse, from a usb_mice slot of their own.
+struct SynthMotion {
+    uint8_t pattern;
+    uint32_t rate_hz;
+    uint8_t amplitude;
+    uint32_t seed;
+    uint32_t rng;
+    uint32_t step;
+    uint32_t next_us;
+    uint32_t phase_start_us;
+    uint32_t reports;
+    struct UsbMouse *mouse;
+};
+
+static struct SynthMotion synth_motion = {
+    .pattern = RT_SYNTH,
+    .rate_hz = RT_SYNTH_RATE_HZ,
+    .amplitude = RT_SYNTH_AMPLITUDE,
+    .seed = RT_SYNTH_SEED,
+};
+
+// Flight recorder state.  Events are not recorded while a dump is in
+// progress, so that the dump shows what led to the trigger.
+struct FlightRecorder {
+    volatile uint32_t head;         // events recorded so far
+    volatile bool frozen;
+    bool auto_dump;
+    bool triggered;
+    uint8_t trigger;
+    uint32_t trigger_us;
+    uint32_t last_dump_us;
+    uint32_t dump_pos;              // next event to print while frozen
+    uint32_t dumps;
+    uint32_t overrun_errors;        // seen by the last check
+    uint32_t reset_window_us;
+    uint32_t reset_window_resets;   // rt_resets at the start of the window
+};
+
+static struct FlightRecorder flight_recorder = {
+    .auto_dump = RT_FR_AUTO_DUMP,
+};
 
-// RT mouse protocol constants
-#define RT_MOUSE_DATA_REPORT 0x0b
-#define RT_MOUSE_STATUS_REPORT 0x61
-#define RT_MOUSE_RESET_ACK 0xff
-#define RT_MOUSE_CONFIGURED 0x20
-
-// RT mouse protocol commands
-#define MOUSE_CMD_RESET 0x01
-#define MOUSE_CMD_READ_CONFIG 0x06
-#define MOUSE_CMD_ENABLE 0x08
-#define MOUSE_CMD_DISABLE 0x09
-#define MOUSE_CMD_READ_DATA 0x0b
-#define MOUSE_CMD_WRAP_ON 0x0e
-#define MOUSE_CMD_WRAP_OFF 0x0f
-#define MOUSE_CMD_SET_SCALE_EXP 0x78
-#define MOUSE_CMD_SET_SCALE_LIN 0x6c
-#define MOUSE_CMD_READ_STATUS 0x73
-#define MOUSE_CMD_SET_RATE 0x8a
-#define MOUSE_CMD_SET_MODE 0x8d
-#define MOUSE_CMD_SET_RESOLUTION 0x89
-
-// Mouse state
-struct MouseState {
-    bool initialized;
-    uint8_t last_command;
+static struct FlightEvent fr_events[RT_FR_EVENTS];
+
+static const char *const fr_trigger_names[FR_TRIGGERS] = FR_TRIGGER_NAMES;
+
+// Telemetry state.  head and dropped are written by fr_record, tail by
+// the main loop.
+struct Telemetry {
     bool enabled;
-    bool wrap_mode;
-    char scaling; // 'l' = linear, 'e' = exponential
-    uint8_t resolution;
-    uint8_t sample_rate;
-    char mode; // 's' = stream, 'r' = remote
-    bool left_button;
-    bool middle_button;
-    bool right_button;
+    bool mounted;                   // adapter present
+    uint8_t cdc_idx;
+    uint8_t dev_addr;
+    volatile bool active;           // mounted and enabled, events are queued
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t dropped;      // events lost since the last FR_EVENT_DROPPED
+    uint32_t dropped_total;
+    uint8_t seq;
+    uint32_t records;
+    uint32_t bytes;
 };
 
-static struct MouseState mouse_state = {
-    .initialized = false,
-    .last_command = 0,
-    .enabled = true,
-    .wrap_mode = false,
-    .scaling = 'l',
-    .resolution = 100,
-    .sample_rate = 100,
-    .mode = 's',
-    .left_button = false,
-    .middle_button = false,
-    .right_button = false
+static struct Telemetry telemetry = {
+    .enabled = RT_TELEMETRY,
 };
 
+static struct FlightEvent tm_events[RT_TM_EVENTS];
+
+// Set by the RX interrupt on RESET, pending motion is dropped by the pacer
+static volatile bool pending_motion_discard;
+
+// Set by the RX interrupt on READ_DATA, the pacer sends a report at once
+static volatile bool pending_motion_read;
+
+// Motion retention across a DISABLE ... ENABLE window.  The RX interrupt
+// opens and closes the window, the pacer accounts for it and drops the
+// motion of windows that lasted too long.
+struct MotionRetention {
+    bool enabled;
+    volatile bool active;           // RT disabled, USB motion is still merged
+    volatile bool closed;           // ENABLE seen, window_us is valid
+    uint32_t start_us;
+    uint32_t window_us;
+    uint32_t windows;               // closed in time, motion kept
+    uint32_t expired;               // outlasted RT_RETAIN_MAX_US, motion dropped
+    uint32_t counts_kept;           // |dx| + |dy| sent after a window
+    uint32_t presses_replayed;      // buttons both pressed and released within a window
+    uint32_t window_max_us;
+};
+
+static struct MotionRetention motion_retention = {
+    .enabled = RT_RETAIN_MOTION,
+};
+
+// SysTick runs from the system clock and is used as a cycle counter,
+// it counts down and wraps after 2^24 cycles
+static inline uint32_t cycle_count(void) {
+    return systick_hw->cvr;
+}
+
+static inline void __not_in_flash_func(timing_stats_add)(struct TimingStats *stats, uint32_t value) {
+    if (!stats->count || value < stats->min) stats->min = value;
+    if (value > stats->max) stats->max = value;
+    stats->total += value;
+    stats->count++;
+}
+
+static inline void __not_in_flash_func(cycle_stats_add)(struct TimingStats *stats, uint32_t start) {
+    timing_stats_add(stats, (start - cycle_count()) & 0xffffff);
+}
+
+void init_cycle_counter() {
+    systick_hw->rvr = 0xffffff;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+}
+
 // Define our own mouse report structure to match the 3-byte format
 struct mouse_report {
     uint8_t buttons;
@@ -83,23 +445,277 @@ void print_hex_dump(const char *prefix, const uint8_t *data, size_t len) {
     printf("\n");
 }
 
-// Forward declaration of send_mouse_report_uart
-void send_mouse_report_uart(const uint8_t report[4]);
+// Line traffic log, written from interrupt context and printed by the
+// main loop so that the RX interrupt never blocks on the debug UART.
+struct RtLogEntry {
+    bool tx;
+    uint8_t len;
+    uint8_t data[4];
+};
 
-// UART1 initialization
-void init_rt_uart() {
-    printf("Initializing UART1: baud=%d, data=%d, stop=%d, parity=%d\n",
-           RT_UART_BAUD, RT_UART_DATA_BITS, RT_UART_STOP_BITS, RT_UART_PARITY);
+static struct RtLogEntry rt_log[RT_LOG_RING_SIZE];
+static volatile uint32_t rt_log_head;
+static volatile uint32_t rt_log_tail;
 
-    uart_init(RT_UART_ID, RT_UART_BAUD);
+static void __not_in_flash_func(rt_log_add)(bool tx, const uint8_t *data, uint8_t len) {
+    uint32_t save = save_and_disable_interrupts();
+    if (rt_log_head - rt_log_tail < RT_LOG_RING_SIZE) {
+        struct RtLogEntry *entry = &rt_log[rt_log_head % RT_LOG_RING_SIZE];
+        entry->tx = tx;
+        entry->len = len;
+        memcpy(entry->data, data, len);
+        rt_log_head++;
+    } else {
+        debug_stats.log_overflows++;
+    }
+    restore_interrupts(save);
+}
+
+// Queue an event for the telemetry adapter.  When the ring is full the
+// event is counted, and the count goes out ahead of the next event that
+// fits.  Must be called with interrupts disabled.
+static void __not_in_flash_func(tm_queue)(const struct FlightEvent *event) {
+    struct Telemetry *tm = &telemetry;
+    uint32_t free = RT_TM_EVENTS - (tm->head - tm->tail);
+    if (tm->dropped && free >= 2) {
+        uint32_t dropped = tm->dropped < 0xffff ? tm->dropped : 0xffff;
+        struct FlightEvent *marker = &tm_events[tm->head & (RT_TM_EVENTS - 1)];
+        *marker = (struct FlightEvent) {
+            .time_us = event->time_us,
+            .type = FR_EVENT_DROPPED,
+            .len = 2,
+            .data = { (uint8_t)dropped, (uint8_t)(dropped >> 8) },
+        };
+        tm->head++;
+        tm->dropped = 0;
+        free--;
+    }
+    if (!tm->dropped && free) {
+        tm_events[tm->head & (RT_TM_EVENTS - 1)] = *event;
+        tm->head++;
+    } else {
+        tm->dropped++;
+        tm->dropped_total++;
+    }
+}
+
+// Record an event, callable from interrupt and thread context
+static void __not_in_flash_func(fr_record)(uint8_t type, const uint8_t *data, uint8_t len) {
+    uint32_t save = save_and_disable_interrupts();
+    struct FlightEvent event = { .time_us = time_us_32(), .type = type, .len = len };
+    memcpy(event.data, data, len);
+    if (!flight_recorder.frozen) {
+        fr_events[flight_recorder.head & (RT_FR_EVENTS - 1)] = event;
+        flight_recorder.head++;
+    }
+    if (telemetry.active) {
+        tm_queue(&event);
+    }
+    trace_log_record(&event);
+    restore_interrupts(save);
+}
+
+// RT transmit ring, drained into UART1 by the TX interrupt
+static uint8_t rt_tx_ring[RT_TX_RING_SIZE];
+static volatile uint32_t rt_tx_head;
+static volatile uint32_t rt_tx_tail;
+
+// Move bytes from the ring into the UART and keep the TX interrupt
+// enabled only while there is something left to send.  Must be called
+// with interrupts disabled.
+static void __not_in_flash_func(rt_tx_fill)(void) {
+    while (rt_tx_tail != rt_tx_head && uart_is_writable(RT_UART_ID)) {
+        uart_get_hw(RT_UART_ID)->dr = rt_tx_ring[rt_tx_tail % RT_TX_RING_SIZE];
+        rt_tx_tail++;
+    }
+    if (rt_tx_tail != rt_tx_head) {
+        hw_set_bits(&uart_get_hw(RT_UART_ID)->imsc, UART_UARTIMSC_TXIM_BITS);
+    } else {
+        hw_clear_bits(&uart_get_hw(RT_UART_ID)->imsc, UART_UARTIMSC_TXIM_BITS);
+    }
+}
+
+// Queue a packet atomically so that responses sent from the RX
+// interrupt never interleave with data reports sent from the main loop.
+static bool __not_in_flash_func(rt_tx_queue)(const uint8_t *packet, uint32_t len, uint32_t reserve) {
+    uint32_t save = save_and_disable_interrupts();
+    bool queued = RT_TX_RING_SIZE - (rt_tx_head - rt_tx_tail) >= len + reserve;
+    if (queued) {
+        for (uint32_t i = 0; i < len; i++) {
+            rt_tx_ring[rt_tx_head % RT_TX_RING_SIZE] = packet[i];
+            rt_tx_head++;
+        }
+        debug_stats.tx_bytes += len;
+        fr_record(FR_EVENT_RT_TX, packet, (uint8_t)len);
+        rt_tx_fill();
+    }
+    restore_interrupts(save);
+    return queued;
+}
+
+// Count the errors flagged with a received character.  The receive
+// status register latches the same flags, it is cleared so that it
+// only ever reflects the most recent error.
+static void __not_in_flash_func(rt_count_line_errors)(uint32_t data) {
+    if (data & UART_UARTDR_FE_BITS) debug_stats.framing_errors++;
+    if (data & UART_UARTDR_PE_BITS) debug_stats.parity_errors++;
+    if (data & UART_UARTDR_BE_BITS) debug_stats.break_errors++;
+    if (data & UART_UARTDR_OE_BITS) debug_stats.overrun_errors++;
+    uart_get_hw(RT_UART_ID)->rsr = 0;
+}
+
+// GPIO interrupt on both edges of the RX pin while auto-baud is enabled
+static void __not_in_flash_func(rt_rx_edge_irq)(uint gpio, uint32_t events) {
+    uint32_t now = time_us_32();
+    uint32_t width = now - autobaud.last_edge_us;
+    autobaud.last_edge_us = now;
+    if (width > RT_AUTOBAUD_IDLE_US) {
+        autobaud.min_edge_us = UINT32_MAX;
+    } else if (width >= RT_AUTOBAUD_MIN_BIT_US && width < autobaud.min_edge_us) {
+        autobaud.min_edge_us = width;
+    }
+}
+
+// Called from the RX interrupt when a character arrived with a framing,
+// parity or break error, which is what a command sent at another speed
+// looks like.  The character is lost, the RT driver retries.
+static void __not_in_flash_func(rt_autobaud_detect)(void) {
+    uint32_t bit_us = autobaud.min_edge_us;
+    if (bit_us == UINT32_MAX) {
+        return;
+    }
+    debug_stats.autobaud_bit_us = bit_us;
+    for (size_t i = 0; i < sizeof(rt_uart_rates) / sizeof(rt_uart_rates[0]); i++) {
+        const struct RtUartRate *rate = &rt_uart_rates[i];
+        if (bit_us + rate->tolerance_us >= rate->bit_us && bit_us <= rate->bit_us + rate->tolerance_us) {
+            if (rate->baud != rt_uart_baud) {
+                // What uart_set_baudrate() does, the LCR_H write latches
+                // the new divisor
+                rt_uart_baud = rate->baud;
+                uart_get_hw(RT_UART_ID)->ibrd = rate->ibrd;
+                uart_get_hw(RT_UART_ID)->fbrd = rate->fbrd;
+                hw_set_bits(&uart_get_hw(RT_UART_ID)->lcr_h, 0);
+                debug_stats.autobaud_switches++;
+            }
+            autobaud.min_edge_us = UINT32_MAX;
+            return;
+        }
+    }
+    debug_stats.autobaud_failures++;
+}
+
+// The edge interrupt has to be timed as precisely as the RX interrupt,
+// so while auto-baud is enabled the GPIO bank interrupt runs at the
+// highest priority.  That applies to every GPIO interrupt callback, the
+// firmware has no other.
+void rt_autobaud_enable(bool enabled) {
+    autobaud.min_edge_us = UINT32_MAX;
+    autobaud.enabled = enabled;
+    gpio_set_irq_enabled_with_callback(RT_UART_RX_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL,
+                                       enabled, rt_rx_edge_irq);
+    irq_set_priority(IO_IRQ_BANK0, enabled ? PICO_HIGHEST_IRQ_PRIORITY : PICO_DEFAULT_IRQ_PRIORITY);
+}
+
+// UART1 interrupt: answer commands as soon as they arrive and keep the
+// transmitter busy.  Runs from SRAM so that it is not delayed by XIP
+// cache misses while the USB stack is being brought up.
+static void __not_in_flash_func(rt_uart_irq)(void) {
+    while (uart_is_readable(RT_UART_ID)) {
+        uint32_t start = cycle_count();
+        uint32_t data = uart_get_hw(RT_UART_ID)->dr;
+        uint8_t cmd = (uint8_t)data;
+        if (data & (UART_UARTDR_FE_BITS | UART_UARTDR_PE_BITS | UART_UARTDR_BE_BITS | UART_UARTDR_OE_BITS)) {
+            rt_count_line_errors(data);
+            uint8_t error[2] = { (uint8_t)(data >> 8), cmd };
+            fr_record(FR_EVENT_LINE_ERROR, error, sizeof(error));
+            rt_engine_line_error();
+            if (data & (UART_UARTDR_FE_BITS | UART_UARTDR_PE_BITS | UART_UARTDR_BE_BITS)) {
+                if (autobaud.enabled) {
+                    rt_autobaud_detect();
+                }
+                continue;
+            }
+            // Overrun: this character is fine, but one before it was lost
+        }
+        if (loopback_test.active) {
+            loopback_test.rx_cycles = start;
+            loopback_test.rx_byte = cmd;
+            loopback_test.received = true;
+            continue;
+        }
+        if (!debug_stats.boot_first_cmd_us) {
+            debug_stats.boot_first_cmd_us = time_us_32();
+        }
+        debug_stats.rx_bytes++;
+        rt_log_add(false, &cmd, 1);
+        fr_record(FR_EVENT_RT_RX, &cmd, 1);
+        uint32_t events = handle_rt_mouse_command(cmd);
+        if ((events & RT_EVENT_DISABLE) && motion_retention.enabled) {
+            if (!motion_retention.active) {
+                motion_retention.active = true;
+                motion_retention.start_us = time_us_32();
+            }
+        } else if (events & (RT_EVENT_RESET | RT_EVENT_DISABLE)) {
+            motion_retention.active = false;
+            pending_motion_discard = true;
+        }
+        if ((events & RT_EVENT_ENABLE) && motion_retention.active) {
+            motion_retention.active = false;
+            motion_retention.window_us = time_us_32() - motion_retention.start_us;
+            motion_retention.closed = true;
+        }
+        if (events & RT_EVENT_RESET) {
+            debug_stats.rt_resets++;
+        }
+        if (events & RT_EVENT_READ_DATA) {
+            pending_motion_read = true;
+        }
+        cycle_stats_add(&debug_stats.rx_irq_cycles, start);
+    }
+    uint32_t save = save_and_disable_interrupts();
+    rt_tx_fill();
+    restore_interrupts(save);
+}
+
+// UART1 initialization.  This runs before anything else in main() so
+// that the RT can be answered while USB and stdio are still coming up,
+// hence no printf here; see print_rt_uart_config().
+void init_rt_uart() {
+    uart_init(RT_UART_ID, rt_uart_baud);
+    // Divisors as uart_set_baudrate() computes them
+    for (size_t i = 0; i < sizeof(rt_uart_rates) / sizeof(rt_uart_rates[0]); i++) {
+        struct RtUartRate *rate = &rt_uart_rates[i];
+        uint32_t div = 8 * clock_get_hz(clk_peri) / rate->baud + 1;
+        rate->bit_us = (uint16_t)(1000000 / rate->baud);
+        rate->tolerance_us = (uint16_t)(rate->bit_us * RT_AUTOBAUD_TOLERANCE_PCT / 100);
+        rate->ibrd = (uint16_t)(div >> 7);
+        rate->fbrd = (uint8_t)((div & 0x7f) >> 1);
+    }
     uart_set_format(RT_UART_ID, RT_UART_DATA_BITS, RT_UART_STOP_BITS, RT_UART_PARITY);
     uart_set_hw_flow(RT_UART_ID, false, false);
-    uart_set_fifo_enabled(RT_UART_ID, true);
+    // Without FIFOs every received byte raises an interrupt right away
+    // instead of waiting for the 32 bit period receive timeout.
+    uart_set_fifo_enabled(RT_UART_ID, false);
 
     // Set pins to UART function
     gpio_set_function(RT_UART_TX_PIN, GPIO_FUNC_UART);
     gpio_set_function(RT_UART_RX_PIN, GPIO_FUNC_UART);
 
+    irq_set_exclusive_handler(RT_UART_IRQ, rt_uart_irq);
+    // The RT line must not wait for the USB controller interrupt
+    irq_set_priority(RT_UART_IRQ, PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_enabled(RT_UART_IRQ, true);
+    uart_set_irq_enables(RT_UART_ID, true, false);
+
+    if (autobaud.enabled) {
+        rt_autobaud_enable(true);
+    }
+}
+
+void print_rt_uart_config() {
+    printf("Initializing UART1: baud=%d, data=%d, stop=%d, parity=%d\n",
+           (int)rt_uart_baud, RT_UART_DATA_BITS, RT_UART_STOP_BITS, RT_UART_PARITY);
+
     // Verify UART is enabled
     if (uart_is_enabled(RT_UART_ID)) {
         printf("UART1 enabled successfully\n");
@@ -108,181 +724,901 @@ void init_rt_uart() {
     }
 }
 
-// Send 4-byte RT mouse report over UART1
-void send_mouse_report_uart(const uint8_t report[4]) {
-    print_hex_dump("UART TX", report, 4);
-    if (!uart_is_enabled(RT_UART_ID)) {
-        printf("ERROR: UART1 not enabled when trying to send data!\n");
-        return;
+// Queue a response to a command or a wrap echo, called from the RX
+// interrupt
+void __not_in_flash_func(send_response_uart)(const uint8_t *response, uint32_t len) {
+    if (!debug_stats.boot_first_response_us) {
+        debug_stats.boot_first_response_us = time_us_32();
     }
-    uart_write_blocking(RT_UART_ID, report, 4);
+    rt_tx_queue(response, len, 0);
+    rt_log_add(true, response, len);
 }
 
-// Send status report over UART1
-void send_status_report_uart() {
-    uint8_t status[4] = {
-        RT_MOUSE_STATUS_REPORT,
-        (mouse_state.enabled ? 0x00 : 0x20) |
-        (mouse_state.scaling == 'e' ? 0x10 : 0x00) |
-        (mouse_state.mode == 'r' ? 0x08 : 0x00) |
-        0x04,
-        mouse_state.resolution,
-        mouse_state.sample_rate
-    };
-    send_mouse_report_uart(status);
+// Check for room for a data report while keeping the response reserve
+static bool __not_in_flash_func(rt_tx_can_queue_report)(void) {
+    return RT_TX_RING_SIZE - (rt_tx_head - rt_tx_tail) >= 4 + RT_TX_RESERVE;
 }
 
-// Send reset ack over UART1
-void send_reset_ack_uart() {
-    uint8_t ack[4] = {RT_MOUSE_RESET_ACK, 0x08, 0x00, 0x00};
-    send_mouse_report_uart(ack);
+// The pacer binds motion to a packet as late as possible: only once
+// everything queued before has been handed to the UART
+static bool __not_in_flash_func(rt_tx_idle)(void) {
+    return rt_tx_head == rt_tx_tail;
 }
 
-// Send config response over UART1
-void send_configured_uart() {
-    uint8_t conf[4] = {RT_MOUSE_CONFIGURED, 0x00, 0x00, 0x00};
-    send_mouse_report_uart(conf);
+// Send a data report over UART1, waiting for room in the ring.  The
+// report is dumped later by the main loop like the responses, printing
+// on the debug UART here would stall the pacer for milliseconds.
+void __not_in_flash_func(send_mouse_report_uart)(const uint8_t *report, uint32_t len) {
+    while (!rt_tx_queue(report, len, RT_TX_RESERVE)) {
+        tight_loop_contents();
+    }
+    rt_log_add(true, report, len);
 }
 
 #define min(x, y) ((x) < (y) ? (x) : (y))
 #define max(x, y) ((x) > (y) ? (x) : (y))
 
-// Translate TinyUSB mouse report to RT PC format and send over UART1
-void send_rt_mouse_data(const struct mouse_report *report) {
-    uint8_t status = 0;
-    if (report->buttons & 0x01) status |= 0x20; // left
-    if (report->buttons & 0x02) status |= 0x80; // right
-    if (report->buttons & 0x04) status |= 0x40; // middle
-
-    int8_t x = report->x;
-    int8_t y = -report->y;
-
-    // Set sign bits in status byte
-    if (x < 0) status |= 0x04;
-    if (y < 0) status |= 0x02;
-
-    uint8_t out[4] = {
-        RT_MOUSE_DATA_REPORT,
-        status,
-        report->x > 0 ? min(127, x) : max(-127, x),
-        report->y > 0 ? min(127, y) : max(-127, y),
-    };
-    send_mouse_report_uart(out);
-}
-
-// Handle RT mouse protocol commands from host
-void handle_rt_mouse_command(uint8_t cmd) {
-    print_hex_dump("UART RX", &cmd, 1);
-    switch (cmd) {
-        case MOUSE_CMD_RESET:
-            send_reset_ack_uart();
-            mouse_state.initialized = false;
-            mouse_state.enabled = true;
-            mouse_state.last_command = 0;
+// Print RT line traffic logged by the interrupt handler
+void poll_rt_mouse_uart() {
+    while (rt_log_tail != rt_log_head) {
+        struct RtLogEntry entry = rt_log[rt_log_tail % RT_LOG_RING_SIZE];
+        rt_log_tail++;
+        print_hex_dump(entry.tx ? "UART TX" : "UART RX", entry.data, entry.len);
+    }
+}
+
+void print_timing_stats(const char *name, const struct TimingStats *stats, const char *unit) {
+    if (stats->count) {
+        printf("%s: %lu samples, min %lu, avg %lu, max %lu %s (jitter %lu %s)\n",
+               name, (unsigned long)stats->count, (unsigned long)stats->min,
+               (unsigned long)(stats->total / stats->count), (unsigned long)stats->max, unit,
+               (unsigned long)(stats->max - stats->min), unit);
+    }
+}
+
+void print_synth_motion() {
+    printf("Synthetic motion: %s, %lu Hz, amplitude %d, seed %lu, %lu reports\n",
+           synth_pattern_names[synth_motion.pattern], (unsigned long)synth_motion.rate_hz,
+           synth_motion.amplitude, (unsigned long)synth_motion.seed,
+           (unsigned long)synth_motion.reports);
+}
+
+void print_motion_retention() {
+    const struct MotionRetention *mr = &motion_retention;
+    printf("Retention: %s, %lu windows kept (longest %lu us), %lu expired, %lu counts kept, %lu presses replayed\n",
+           mr->enabled ? "on" : "off", (unsigned long)mr->windows, (unsigned long)mr->window_max_us,
+           (unsigned long)mr->expired, (unsigned long)mr->counts_kept, (unsigned long)mr->presses_replayed);
+}
+
+void print_telemetry() {
+    if (telemetry.mounted) {
+        printf("Telemetry: adapter dev_addr=%d, %s, %lu records, %lu bytes, %lu events dropped\n",
+               telemetry.dev_addr, telemetry.enabled ? "on" : "off", (unsigned long)telemetry.records,
+               (unsigned long)telemetry.bytes, (unsigned long)telemetry.dropped_total);
+    } else {
+        printf("Telemetry: %s, no adapter\n", telemetry.enabled ? "on" : "off");
+    }
+}
+
+void print_debug_stats() {
+    printf("Boot: main %lu us, RT ready %lu us, USB ready %lu us\n",
+           (unsigned long)debug_stats.boot_main_us,
+           (unsigned long)debug_stats.boot_rt_ready_us,
+           (unsigned long)debug_stats.boot_usb_ready_us);
+    if (debug_stats.boot_first_cmd_us) {
+        printf("Boot: first command %lu us, first response %lu us (%lu us to answer)\n",
+               (unsigned long)debug_stats.boot_first_cmd_us,
+               (unsigned long)debug_stats.boot_first_response_us,
+               (unsigned long)(debug_stats.boot_first_response_us - debug_stats.boot_first_cmd_us));
+    }
+    printf("Line: %lu bytes received, %lu bytes sent, %lu log overflows\n",
+           (unsigned long)debug_stats.rx_bytes,
+           (unsigned long)debug_stats.tx_bytes,
+           (unsigned long)debug_stats.log_overflows);
+    printf("USB: %lu attaches, %lu detaches, %lu button releases, %lu short presses, %lu untracked reports\n",
+           (unsigned long)debug_stats.usb_attaches,
+           (unsigned long)debug_stats.usb_detaches,
+           (unsigned long)debug_stats.buttons_released,
+           (unsigned long)debug_stats.short_presses,
+           (unsigned long)debug_stats.usb_untracked_reports);
+    printf("USB: plug to first report %lu us (max %lu us)\n",
+           (unsigned long)debug_stats.plug_to_report_us,
+           (unsigned long)debug_stats.plug_to_report_max_us);
+    for (int i = 0; i < MAX_USB_MICE; i++) {
+        if (usb_mice[i].attached) {
+            printf("USB: mouse %d: dev_addr=%d instance=%d buttons=%02x reports=%lu\n",
+                   i, usb_mice[i].dev_addr, usb_mice[i].instance, usb_mice[i].buttons,
+                   (unsigned long)usb_mice[i].reports);
+        }
+    }
+    print_timing_stats("Timing: RX interrupt", &debug_stats.rx_irq_cycles, "cycles");
+    print_timing_stats("Timing: report", &debug_stats.report_cycles, "cycles");
+    printf("Timing: main loop max %lu us\n", (unsigned long)debug_stats.loop_max_us);
+    print_timing_stats("Latency: newest data age", &debug_stats.data_age_us, "us");
+    print_timing_stats("Latency: oldest data age", &debug_stats.oldest_age_us, "us");
+    printf("Latency: phase lock %s, %lu holds, %lu poll interval overrides\n",
+           rt_phase_lock ? "on" : "off", (unsigned long)debug_stats.phase_lock_holds,
+           (unsigned long)debug_stats.poll_overrides);
+    const struct RtProtocolStats *protocol = rt_protocol_stats();
+    printf("Wrap: %lu bytes echoed\n", (unsigned long)protocol->wrap_echoes);
+    printf("Line errors: %lu framing, %lu parity, %lu break, %lu overrun\n",
+           (unsigned long)debug_stats.framing_errors, (unsigned long)debug_stats.parity_errors,
+           (unsigned long)debug_stats.break_errors, (unsigned long)debug_stats.overrun_errors);
+    printf("Commands: %lu unknown bytes, %lu bad parameters, %lu timeouts, %lu discarded\n",
+           (unsigned long)protocol->cmd_unknown, (unsigned long)protocol->cmd_bad_params,
+           (unsigned long)protocol->cmd_timeouts, (unsigned long)protocol->cmd_discarded);
+    if (protocol->line_error_us) {
+        printf("Commands: recovery after line error %lu us (max %lu us)%s\n",
+               (unsigned long)protocol->recovery_us, (unsigned long)protocol->recovery_max_us,
+               protocol->recovery_pending_done ? "" : ", not yet recovered");
+    }
+    printf("Baud: %lu, auto-baud %s, %lu switches, %lu failures, last bit width %lu us\n",
+           (unsigned long)rt_uart_baud, autobaud.enabled ? "on" : "off",
+           (unsigned long)debug_stats.autobaud_switches, (unsigned long)debug_stats.autobaud_failures,
+           (unsigned long)debug_stats.autobaud_bit_us);
+    if (synth_motion.pattern != SYNTH_OFF) {
+        print_synth_motion();
+    }
+    printf("Acceleration: %s\n", rt_accel_name(rt_accel_selected()));
+    print_motion_retention();
+    printf("Flight recorder: %lu events, %lu dumps, automatic dumps %s, %lu RESET commands\n",
+           (unsigned long)flight_recorder.head, (unsigned long)flight_recorder.dumps,
+           flight_recorder.auto_dump ? "on" : "off", (unsigned long)debug_stats.rt_resets);
+    print_telemetry();
+    trace_log_print_stats();
+    print_timing_stats("Loopback: round trip", &debug_stats.loopback_rtt_ns, "ns");
+    print_timing_stats("Loopback: wire and level shifter", &debug_stats.loopback_wire_ns, "ns");
+    if (debug_stats.loopback_rtt_ns.count || debug_stats.loopback_lost) {
+        printf("Loopback: %lu lost, %lu wrong\n",
+               (unsigned long)debug_stats.loopback_lost, (unsigned long)debug_stats.loopback_errors);
+    }
+}
+
+// Start a new jitter measurement
+void reset_timing_stats() {
+    uint32_t save = save_and_disable_interrupts();
+    memset(&debug_stats.rx_irq_cycles, 0, sizeof(debug_stats.rx_irq_cycles));
+    memset(&debug_stats.report_cycles, 0, sizeof(debug_stats.report_cycles));
+    memset(&debug_stats.data_age_us, 0, sizeof(debug_stats.data_age_us));
+    memset(&debug_stats.oldest_age_us, 0, sizeof(debug_stats.oldest_age_us));
+    debug_stats.loop_max_us = 0;
+    debug_stats.phase_lock_holds = 0;
+    restore_interrupts(save);
+}
+
+// Measure the round trip of the RT line.  This needs a loopback plug
+// that connects RT pins 2 and 6 at the far end of the cable, so that
+// the adapter receives what it sends.  Each byte is written while the
+// transmitter is idle and timestamped in the RX interrupt.  The UART
+// delivers a byte in the middle of its stop bit, 10.5 bit times after
+// the start bit, what is left is wire, level shifter and interrupt
+// entry time.
+void run_loopback_test() {
+    uint32_t clk_hz = clock_get_hz(clk_sys);
+    uint32_t frame_ns = (uint32_t)(10500000000ull / rt_uart_baud);
+    memset(&debug_stats.loopback_rtt_ns, 0, sizeof(debug_stats.loopback_rtt_ns));
+    memset(&debug_stats.loopback_wire_ns, 0, sizeof(debug_stats.loopback_wire_ns));
+    debug_stats.loopback_lost = 0;
+    debug_stats.loopback_errors = 0;
+
+    while (!rt_tx_idle() || (uart_get_hw(RT_UART_ID)->fr & UART_UARTFR_BUSY_BITS)) {
+        tight_loop_contents();
+    }
+    loopback_test.active = true;
+    for (int i = 0; i < RT_LOOPBACK_BYTES; i++) {
+        uint8_t byte = (uint8_t)(i & 1 ? 0x55 + i : 0xaa - i);
+        loopback_test.received = false;
+        uint32_t save = save_and_disable_interrupts();
+        uint32_t tx_cycles = cycle_count();
+        uart_get_hw(RT_UART_ID)->dr = byte;
+        restore_interrupts(save);
+        uint32_t start_us = time_us_32();
+        while (!loopback_test.received && time_us_32() - start_us < RT_LOOPBACK_TIMEOUT_US) {
+            tight_loop_contents();
+        }
+        if (!loopback_test.received) {
+            debug_stats.loopback_lost++;
+        } else if (loopback_test.rx_byte != byte) {
+            debug_stats.loopback_errors++;
+        } else {
+            uint32_t cycles = (tx_cycles - loopback_test.rx_cycles) & 0xffffff;
+            uint32_t rtt_ns = (uint32_t)((uint64_t)cycles * 1000000000ull / clk_hz);
+            timing_stats_add(&debug_stats.loopback_rtt_ns, rtt_ns);
+            timing_stats_add(&debug_stats.loopback_wire_ns, rtt_ns > frame_ns ? rtt_ns - frame_ns : 0);
+        }
+        // Let the line settle so that the next byte starts from idle
+        while (uart_get_hw(RT_UART_ID)->fr & UART_UARTFR_BUSY_BITS) {
+            tight_loop_contents();
+        }
+    }
+    loopback_test.active = false;
+    print_timing_stats("Loopback: round trip", &debug_stats.loopback_rtt_ns, "ns");
+    print_timing_stats("Loopback: wire and level shifter", &debug_stats.loopback_wire_ns, "ns");
+    printf("Loopback: %lu lost, %lu wrong\n",
+           (unsigned long)debug_stats.loopback_lost, (unsigned long)debug_stats.loopback_errors);
+}
+
+// Mark an anomaly in the recording and dump it post_us later
+void fr_trigger(uint8_t trigger, uint32_t post_us) {
+    if (flight_recorder.triggered || flight_recorder.frozen) {
+        return;
+    }
+    fr_record(FR_EVENT_TRIGGER, &trigger, 1);
+    flight_recorder.triggered = true;
+    flight_recorder.trigger = trigger;
+    flight_recorder.trigger_us = time_us_32() - (RT_FR_POST_TRIGGER_US - post_us);
+}
+
+// Look for anomalies and print a frozen recording one event per call,
+// so that the main loop keeps serving the pacer during a dump
+void poll_flight_recorder() {
+    struct FlightRecorder *fr = &flight_recorder;
+    uint32_t now = time_us_32();
+    if (fr->frozen) {
+        if (fr->dump_pos != fr->head) {
+            const struct FlightEvent *event = &fr_events[fr->dump_pos & (RT_FR_EVENTS - 1)];
+            fr->dump_pos++;
+            printf("FR %08lx %02x ", (unsigned long)event->time_us, event->type);
+            for (int i = 0; i < event->len; i++) {
+                printf("%02x", event->data[i]);
+            }
+            printf("\n");
+        } else {
+            printf("Flight recorder: end of dump\n");
+            fr->frozen = false;
+            fr->triggered = false;
+            fr->last_dump_us = now;
+        }
+        return;
+    }
+    if (fr->triggered) {
+        if (now - fr->trigger_us >= RT_FR_POST_TRIGGER_US) {
+            fr->frozen = true;
+            fr->dumps++;
+            uint32_t count = min(fr->head, RT_FR_EVENTS);
+            fr->dump_pos = fr->head - count;
+            printf("Flight recorder: trigger %s, %lu events, now %08lx\n",
+                   fr_trigger_names[fr->trigger], (unsigned long)count, (unsigned long)now);
+        }
+        return;
+    }
+    if (!fr->auto_dump || (fr->dumps && now - fr->last_dump_us < RT_FR_HOLDOFF_US)) {
+        return;
+    }
+    if (pending_motion.dirty && rt_mouse_state()->enabled && !rt_mouse_state()->wrap_mode &&
+        !loopback_test.active && now - pending_motion.last_sent_us > RT_FR_STALL_US) {
+        fr_trigger(FR_TRIGGER_STALL, RT_FR_POST_TRIGGER_US);
+    } else if (debug_stats.overrun_errors != fr->overrun_errors) {
+        fr->overrun_errors = debug_stats.overrun_errors;
+        fr_trigger(FR_TRIGGER_OVERRUN, RT_FR_POST_TRIGGER_US);
+    } else if (debug_stats.rt_resets - fr->reset_window_resets >= RT_FR_RESET_STORM) {
+        fr->reset_window_resets = debug_stats.rt_resets;
+        fr_trigger(FR_TRIGGER_RESET_STORM, RT_FR_POST_TRIGGER_US);
+    }
+    if (now - fr->reset_window_us >= RT_FR_RESET_STORM_US) {
+        fr->reset_window_us = now;
+        fr->reset_window_resets = debug_stats.rt_resets;
+    }
+}
+
+// Write queued telemetry events to the adapter, as many as TinyUSB's
+// transmit FIFO takes.  The rest waits for the next call, the ring
+// absorbs bursts.
+void poll_telemetry() {
+    struct Telemetry *tm = &telemetry;
+    if (!tm->active) {
+        return;
+    }
+    uint32_t written = 0;
+    while (written < RT_TM_EVENTS_PER_POLL && tm->tail != tm->head) {
+        uint8_t frame[TM_FRAME_MAX];
+        size_t len = tm_encode_event(tm->seq, &tm_events[tm->tail & (RT_TM_EVENTS - 1)], frame);
+        if (tuh_cdc_write_available(tm->cdc_idx) < len) {
+            break;
+        }
+        tuh_cdc_write(tm->cdc_idx, frame, len);
+        tm->tail++;
+        tm->seq++;
+        tm->records++;
+        tm->bytes += len;
+        written++;
+    }
+    if (written) {
+        tuh_cdc_write_flush(tm->cdc_idx);
+    }
+}
+
+// Start or stop queueing events for the adapter.  The ring starts empty
+// so that the stream picks up with current events.
+void telemetry_update() {
+    struct Telemetry *tm = &telemetry;
+    uint32_t save = save_and_disable_interrupts();
+    tm->active = tm->mounted && tm->enabled;
+    tm->tail = tm->head;
+    tm->dropped = 0;
+    restore_interrupts(save);
+}
+
+// Synthetic motion generator, defined with the USB mouse handling
+void synth_restart(void);
+
+// Handle single-key commands typed on the debug UART
+void poll_debug_console() {
+    int c = getchar_timeout_us(0);
+    switch (c) {
+        case 's':
+            print_debug_stats();
             break;
-        case MOUSE_CMD_READ_CONFIG:
-            send_configured_uart();
-            mouse_state.initialized = true;
-            mouse_state.last_command = cmd;
+        case 'j':
+            reset_timing_stats();
+            printf("Timing statistics reset\n");
             break;
-        case MOUSE_CMD_ENABLE:
-            mouse_state.enabled = true;
-            mouse_state.last_command = cmd;
+        case 'b':
+            rt_autobaud_enable(!autobaud.enabled);
+            printf("Auto-baud %s\n", autobaud.enabled ? "on" : "off");
             break;
-        case MOUSE_CMD_DISABLE:
-            mouse_state.enabled = false;
-            mouse_state.last_command = cmd;
+        case 'l':
+            printf("Loopback test, RT pins 2 and 6 must be connected\n");
+            run_loopback_test();
             break;
-        case MOUSE_CMD_WRAP_ON:
-            mouse_state.wrap_mode = true;
-            mouse_state.last_command = cmd;
+        case 'p':
+            rt_phase_lock = !rt_phase_lock;
+            reset_timing_stats();
+            printf("Phase lock %s, timing statistics reset\n", rt_phase_lock ? "on" : "off");
             break;
-        case MOUSE_CMD_WRAP_OFF:
-            mouse_state.wrap_mode = false;
-            mouse_state.last_command = cmd;
+        case 'f':
+            fr_trigger(FR_TRIGGER_REQUEST, 0);
             break;
-        case MOUSE_CMD_SET_SCALE_EXP:
-            mouse_state.scaling = 'e';
-            mouse_state.last_command = cmd;
+        case 'F':
+            flight_recorder.auto_dump = !flight_recorder.auto_dump;
+            printf("Flight recorder automatic dumps %s\n", flight_recorder.auto_dump ? "on" : "off");
             break;
-        case MOUSE_CMD_SET_SCALE_LIN:
-            mouse_state.scaling = 'l';
-            mouse_state.last_command = cmd;
+        case 't':
+            telemetry.enabled = !telemetry.enabled;
+            telemetry_update();
+            print_telemetry();
             break;
-        case MOUSE_CMD_READ_STATUS:
-            send_status_report_uart();
-            mouse_state.last_command = cmd;
+        case 'T':
+            trace_log_enable(!trace_log_enabled());
+            trace_log_print_stats();
             break;
-        case MOUSE_CMD_SET_RATE:
-        case MOUSE_CMD_SET_MODE:
-        case MOUSE_CMD_SET_RESOLUTION:
-            mouse_state.last_command = cmd;
+        case 'd':
+            motion_retention.enabled = !motion_retention.enabled;
+            print_motion_retention();
             break;
-        default:
-            // Handle parameter bytes for SET_RATE, SET_MODE, SET_RESOLUTION
-            switch (mouse_state.last_command) {
-                case MOUSE_CMD_SET_RATE:
-                    mouse_state.sample_rate = cmd;
-                    break;
-                case MOUSE_CMD_SET_MODE:
-                    mouse_state.mode = (cmd == 0x03) ? 'r' : 's';
-                    break;
-                case MOUSE_CMD_SET_RESOLUTION:
-                    mouse_state.resolution = cmd;
-                    break;
-                default:
-                    break;
+        case 'c':
+            rt_accel_select((rt_accel_selected() + 1) % rt_accel_profiles());
+            printf("Acceleration: %s\n", rt_accel_name(rt_accel_selected()));
+            break;
+        case 'g':
+            synth_motion.pattern = (synth_motion.pattern + 1) % SYNTH_PATTERNS;
+            synth_restart();
+            reset_timing_stats();
+            print_synth_motion();
+            break;
+        case 'r': {
+            static const uint16_t rates[] = { 125, 250, 500, 1000 };
+            size_t i = 0;
+            while (i < sizeof(rates) / sizeof(rates[0]) && rates[i] <= synth_motion.rate_hz) {
+                i++;
+            }
+            synth_motion.rate_hz = rates[i % (sizeof(rates) / sizeof(rates[0]))];
+            synth_restart();
+            reset_timing_stats();
+            print_synth_motion();
+            break;
+        }
+        case 'a': {
+            static const uint8_t amplitudes[] = { 1, 8, 32, 127 };
+            size_t i = 0;
+            while (i < sizeof(amplitudes) && amplitudes[i] <= synth_motion.amplitude) {
+                i++;
             }
-            mouse_state.last_command = 0;
+            synth_motion.amplitude = amplitudes[i % sizeof(amplitudes)];
+            synth_restart();
+            reset_timing_stats();
+            print_synth_motion();
+            break;
+        }
+        default:
             break;
     }
 }
 
-// Poll UART1 for incoming RT mouse protocol commands
-void poll_rt_mouse_uart() {
-    while (uart_is_readable(RT_UART_ID)) {
-        uint8_t cmd = uart_getc(RT_UART_ID);
-        handle_rt_mouse_command(cmd);
+// Account for a retention window the RT closed with ENABLE, or end one
+// the RT has kept open for longer than a status query takes.  Button
+// changes undone within the window are latched in pending_motion like
+// any other, and sent as a report of each state.
+static void __not_in_flash_func(service_motion_retention)(void) {
+    struct MotionRetention *mr = &motion_retention;
+    uint32_t save = save_and_disable_interrupts();
+    bool closed = mr->closed;
+    uint32_t window_us = mr->window_us;
+    mr->closed = false;
+    if (!closed && mr->active && time_us_32() - mr->start_us > RT_RETAIN_MAX_US) {
+        mr->active = false;
+        closed = true;
+        window_us = time_us_32() - mr->start_us;
+    }
+    restore_interrupts(save);
+    if (!closed) {
+        return;
+    }
+    if (window_us > RT_RETAIN_MAX_US) {
+        mr->expired++;
+        pending_motion.dx = 0;
+        pending_motion.dy = 0;
+        pending_motion.pressed = 0;
+        pending_motion.released = 0;
+        pending_motion.dirty = false;
+    } else {
+        mr->windows++;
+        mr->window_max_us = max(mr->window_max_us, window_us);
+        mr->counts_kept += (uint32_t)abs(pending_motion.dx) + (uint32_t)abs(pending_motion.dy);
+        if (pending_motion.pressed & pending_motion.released) {
+            mr->presses_replayed++;
+        }
+    }
+}
+
+// Send accumulated motion to the RT, at most one report per sample
+// period and only when the line is idle.  Motion beyond the 7-bit
+// range of a report is carried over into the next one.
+//
+// The USB poll and the RT sample period are not related, so a due
+// report is held for up to one poll interval if a fresher USB report
+// is about to arrive.  This locks emission to the phase of the USB
+// frames the motion arrives in, at the cost of shifting the RT slot by
+// less than one poll interval.
+void __not_in_flash_func(service_rt_pacer)() {
+    if (pending_motion_discard) {
+        pending_motion_discard = false;
+        pending_motion.dx = 0;
+        pending_motion.dy = 0;
+        pending_motion.pressed = 0;
+        pending_motion.released = 0;
+        pending_motion.dirty = false;
+    }
+    service_motion_retention();
+    const struct MouseState *mouse_state = rt_mouse_state();
+    if (mouse_state->wrap_mode || loopback_test.active || !rt_tx_idle()) {
+        return;
+    }
+    uint32_t now = time_us_32();
+    uint32_t newest_age_us = now - pending_motion.newest_report_us;
+    uint32_t oldest_age_us = now - pending_motion.oldest_report_us;
+    if (pending_motion_read) {
+        // READ_DATA is answered right away with whatever is pending
+        pending_motion_read = false;
+    } else {
+        if (!mouse_state->enabled || !pending_motion.dirty) {
+            return;
+        }
+        uint32_t interval_us = rt_engine_report_interval_us();
+        if (RT_AUTOBAUD_SCALE_RATE && rt_uart_baud > RT_UART_BAUD) {
+            interval_us = interval_us * RT_UART_BAUD / rt_uart_baud;
+        }
+        if (now - pending_motion.last_sent_us < interval_us) {
+            return;
+        }
+        if (rt_phase_lock && newest_age_us > RT_FRESH_DATA_US &&
+            newest_age_us < pending_motion.report_interval_us + RT_PHASE_LOCK_SLACK_US) {
+            if (!pending_motion.phase_lock_holding) {
+                pending_motion.phase_lock_holding = true;
+                debug_stats.phase_lock_holds++;
+            }
+            return;
+        }
+        pending_motion.phase_lock_holding = false;
+        timing_stats_add(&debug_stats.data_age_us, newest_age_us);
+        timing_stats_add(&debug_stats.oldest_age_us, oldest_age_us);
+    }
+    uint32_t start = cycle_count();
+    pending_motion.last_sent_us = now;
+    pending_motion.oldest_report_us = now;
+    // Each button takes one step away from the last packet: a latched
+    // press or release goes out now even if it was undone again, the
+    // current state in a later report.  A button that went both ways
+    // and ended where this report leaves it owes the RT one more round
+    // trip, which is latched again.
+    uint8_t sent = pending_motion.sent_buttons;
+    uint8_t buttons = pending_motion.buttons;
+    uint8_t toggled = (sent & pending_motion.released) | (~sent & pending_motion.pressed) | (sent ^ buttons);
+    uint8_t report_buttons = sent ^ toggled;
+    uint8_t again = pending_motion.pressed & pending_motion.released & ~(report_buttons ^ buttons);
+    send_rt_mouse_data(report_buttons, &pending_motion.dx, &pending_motion.dy);
+    pending_motion.sent_buttons = report_buttons;
+    pending_motion.pressed = again & ~report_buttons;
+    pending_motion.released = again & report_buttons;
+    pending_motion.dirty = pending_motion.dx != 0 || pending_motion.dy != 0 || report_buttons != buttons || again;
+    if (report_buttons != buttons || again) {
+        debug_stats.short_presses++;
+    }
+    cycle_stats_add(&debug_stats.report_cycles, start);
+
+    uint32_t carried = (uint32_t)abs(pending_motion.dx) + (uint32_t)abs(pending_motion.dy);
+    newest_age_us = min(newest_age_us, 0xffff);
+    oldest_age_us = min(oldest_age_us, 0xffff);
+    uint8_t pacer[6] = {
+        (uint8_t)newest_age_us, (uint8_t)(newest_age_us >> 8),
+        (uint8_t)oldest_age_us, (uint8_t)(oldest_age_us >> 8),
+        (uint8_t)(rt_tx_head - rt_tx_tail), (uint8_t)min(carried, 0xff),
+    };
+    fr_record(FR_EVENT_PACER, pacer, sizeof(pacer));
+}
+
+// Speed up the interrupt IN endpoints of a mouse.  TinyUSB opens them
+// with the descriptor's bInterval and has no API to change it, so the
+// interval field is rewritten in the RP2040 host endpoint control
+// registers, which the controller reads on every poll.
+void override_usb_poll_interval(uint8_t dev_addr) {
+    if (!USB_POLL_INTERVAL_MS) {
+        return;
+    }
+    if (tuh_speed_get(dev_addr) != TUSB_SPEED_FULL && !USB_POLL_OVERRIDE_LOW_SPEED) {
+        return;
+    }
+    usb_host_dpram_t *dpram = (usb_host_dpram_t *)USBCTRL_DPRAM_BASE;
+    for (uint i = 0; i < USB_HOST_INTERRUPT_ENDPOINTS; i++) {
+        uint32_t addr_ctrl = usb_hw->int_ep_addr_ctrl[i];
+        if (!(usb_hw->int_ep_ctrl & (1u << (i + 1))) ||
+            (addr_ctrl & USB_ADDR_ENDP1_ADDRESS_BITS) != dev_addr ||
+            (addr_ctrl & USB_ADDR_ENDP1_INTEP_DIR_BITS)) {
+            continue;
+        }
+        uint32_t ctrl = dpram->int_ep_ctrl[i].ctrl;
+        uint32_t interval = (uint32_t)(USB_POLL_INTERVAL_MS - 1) << EP_CTRL_HOST_INTERRUPT_INTERVAL_LSB;
+        if ((ctrl & EP_CTRL_HOST_INTERRUPT_INTERVAL_BITS) > interval) {
+            dpram->int_ep_ctrl[i].ctrl = (ctrl & ~EP_CTRL_HOST_INTERRUPT_INTERVAL_BITS) | interval;
+            debug_stats.poll_overrides++;
+        }
+    }
+}
+
+// Record the time a device appears on the root port, the earliest point
+// of a plug-in that is visible to us
+void poll_usb_root_port() {
+    static bool connected;
+    bool now_connected = (usb_hw->sie_status & USB_SIE_STATUS_SPEED_BITS) != 0;
+    if (now_connected && !connected) {
+        debug_stats.root_attach_us = time_us_32();
+    }
+    connected = now_connected;
+}
+
+struct UsbMouse *find_usb_mouse(uint8_t dev_addr, uint8_t instance) {
+    if (dev_addr >= USB_MAX_DEV_ADDR || instance >= USB_MAX_HID_INSTANCE) {
+        return NULL;
+    }
+    uint8_t index = usb_mouse_map[dev_addr][instance];
+    return index ? &usb_mice[index - 1] : NULL;
+}
+
+// Merge the buttons of all attached mice into the stream sent to the RT.
+// Only called when the buttons of one mouse change.  Presses and
+// releases are latched until a report carries them, so neither a click
+// nor a release and press again shorter than the sample period is lost.
+void merge_usb_mouse_buttons() {
+    uint8_t buttons = 0;
+    for (int i = 0; i < MAX_USB_MICE; i++) {
+        if (usb_mice[i].attached) {
+            buttons |= usb_mice[i].buttons;
+        }
+    }
+    if (buttons != pending_motion.buttons) {
+        pending_motion.pressed |= buttons & ~pending_motion.buttons;
+        pending_motion.released |= pending_motion.buttons & ~buttons;
+        pending_motion.buttons = buttons;
+        pending_motion.dirty = true;
+    }
+}
+
+// Add the scaled and accelerated motion of one mouse to the merged
+// stream, keeping the fractional part with the mouse it came from.
+// Acceleration is applied per USB report, where the speed of the mouse
+// is known, so that motion the pacer carries over is not accelerated
+// twice.
+void merge_usb_mouse_motion(struct UsbMouse *mouse, int8_t x, int8_t y) {
+    int32_t sx;
+    int32_t sy;
+    rt_accel_scale(mouse->scale_q8, x, y, mouse->report_interval_us, &mouse->frac_x, &mouse->frac_y, &sx, &sy);
+    if (sx || sy) {
+        pending_motion.dx += sx;
+        pending_motion.dy += sy;
+        pending_motion.dirty = true;
+    }
+}
+
+// Take a free usb_mice slot for a mouse interface, returns NULL if all
+// are in use
+struct UsbMouse *attach_usb_mouse(uint8_t dev_addr, uint8_t instance) {
+    if (dev_addr >= USB_MAX_DEV_ADDR || instance >= USB_MAX_HID_INSTANCE) {
+        return NULL;
+    }
+    for (int i = 0; i < MAX_USB_MICE; i++) {
+        struct UsbMouse *mouse = &usb_mice[i];
+        if (!mouse->attached) {
+            *mouse = (struct UsbMouse) {
+                .attached = true,
+                .dev_addr = dev_addr,
+                .instance = instance,
+                .scale_q8 = USB_MOUSE_SCALE_Q8,
+                .mount_us = time_us_32(),
+                .report_interval_us = USB_POLL_INTERVAL_MS ? USB_POLL_INTERVAL_MS * 1000 : 10000,
+            };
+            usb_mouse_map[dev_addr][instance] = (uint8_t)(i + 1);
+            debug_stats.usb_attaches++;
+            uint8_t attach[3] = { (uint8_t)i, dev_addr, instance };
+            fr_record(FR_EVENT_USB_ATTACH, attach, sizeof(attach));
+            return mouse;
+        }
+    }
+    return NULL;
+}
+
+void detach_usb_mouse(struct UsbMouse *mouse) {
+    mouse->attached = false;
+    usb_mouse_map[mouse->dev_addr][mouse->instance] = 0;
+    debug_stats.usb_detaches++;
+    uint8_t detach[3] = { (uint8_t)(mouse - usb_mice), mouse->dev_addr, mouse->instance };
+    fr_record(FR_EVENT_USB_DETACH, detach, sizeof(detach));
+
+    // Motion already accumulated is still sent by the pacer, but make
+    // sure that the RT never sees a button of this mouse stuck down.
+    if (mouse->buttons) {
+        mouse->buttons = 0;
+        merge_usb_mouse_buttons();
+        debug_stats.buttons_released++;
+    }
+}
+
+// Account for a boot protocol report of one mouse and merge its motion
+// and buttons into pending_motion.  Used for real mice and for the
+// synthetic motion generator.
+void handle_usb_mouse_report(struct UsbMouse *mouse, const struct mouse_report *report) {
+    uint8_t event[4] = { (uint8_t)(mouse - usb_mice), report->buttons, (uint8_t)report->x, (uint8_t)report->y };
+    fr_record(FR_EVENT_USB_REPORT, event, sizeof(event));
+    uint32_t now = time_us_32();
+    uint32_t interval_us = now - mouse->last_report_us;
+    if (mouse->reports && interval_us < 20000) {
+        mouse->report_interval_us = (3 * mouse->report_interval_us + interval_us) / 4;
+    }
+    mouse->last_report_us = now;
+    mouse->reports++;
+    // The synthetic mouse was never plugged in
+    if (!mouse->first_report_us && mouse->dev_addr != RT_SYNTH_DEV_ADDR) {
+        mouse->first_report_us = time_us_32();
+        uint32_t plugged_us = debug_stats.root_attach_us ? debug_stats.root_attach_us : mouse->mount_us;
+        debug_stats.plug_to_report_us = mouse->first_report_us - plugged_us;
+        debug_stats.plug_to_report_max_us = max(debug_stats.plug_to_report_max_us,
+                                                debug_stats.plug_to_report_us);
+        debug_stats.root_attach_us = 0;
+    }
+    bool retaining = motion_retention.active && now - motion_retention.start_us <= RT_RETAIN_MAX_US;
+    if (rt_mouse_state()->enabled || retaining) {
+        if (!pending_motion.dirty) {
+            pending_motion.oldest_report_us = now;
+        }
+        pending_motion.newest_report_us = now;
+        pending_motion.report_interval_us = mouse->report_interval_us;
+        merge_usb_mouse_motion(mouse, report->x, report->y);
+        if (report->buttons != mouse->buttons) {
+            mouse->buttons = report->buttons;
+            merge_usb_mouse_buttons();
+        }
     }
 }
 
 // TinyUSB callback: device mounted
 void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *desc_report, uint16_t desc_len) {
-    printf("Mouse detected\n");
     uint8_t itf_protocol = tuh_hid_interface_protocol(dev_addr, instance);
-    if (itf_protocol == HID_ITF_PROTOCOL_MOUSE) {
-        tuh_hid_receive_report(dev_addr, instance);
+    if (itf_protocol != HID_ITF_PROTOCOL_MOUSE) {
+        return;
+    }
+    // Ask for the first report before anything else, printing on the
+    // debug UART takes milliseconds.
+    tuh_hid_receive_report(dev_addr, instance);
+    override_usb_poll_interval(dev_addr);
+
+    if (attach_usb_mouse(dev_addr, instance)) {
+        printf("Mouse detected: dev_addr=%d instance=%d\n", dev_addr, instance);
+    } else {
+        printf("Mouse ignored: dev_addr=%d instance=%d not tracked\n", dev_addr, instance);
     }
 }
 
 // TinyUSB callback: device unmounted
 void tuh_hid_umount_cb(uint8_t dev_addr, uint8_t instance) {
-    printf("Mouse disconnected\n");
+    struct UsbMouse *mouse = find_usb_mouse(dev_addr, instance);
+    if (!mouse) {
+        return;
+    }
+    detach_usb_mouse(mouse);
+    printf("Mouse disconnected: dev_addr=%d instance=%d\n", dev_addr, instance);
 }
 
 // TinyUSB callback: report received
 void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *report, uint16_t len) {
     uint8_t itf_protocol = tuh_hid_interface_protocol(dev_addr, instance);
     if (itf_protocol == HID_ITF_PROTOCOL_MOUSE && len >= 3) {
-        if (mouse_state.enabled) {
-            const struct mouse_report *mouse_report = (const struct mouse_report *)report;
-            send_rt_mouse_data(mouse_report);
+        struct UsbMouse *mouse = find_usb_mouse(dev_addr, instance);
+        if (mouse) {
+            handle_usb_mouse_report(mouse, (const struct mouse_report *)report);
+        } else {
+            debug_stats.usb_untracked_reports++;
         }
     }
     // Request the next report
     tuh_hid_receive_report(dev_addr, instance);
 }
 
+// TinyUSB callback: USB-serial adapter mounted.  The first one becomes
+// the telemetry sink, its line coding was set on enumeration.
+void tuh_cdc_mount_cb(uint8_t idx) {
+    tuh_itf_info_t info;
+    tuh_cdc_itf_get_info(idx, &info);
+    if (telemetry.mounted) {
+        printf("Serial adapter ignored: dev_addr=%d, telemetry already on dev_addr=%d\n",
+               info.daddr, telemetry.dev_addr);
+        return;
+    }
+    telemetry.mounted = true;
+    telemetry.cdc_idx = idx;
+    telemetry.dev_addr = info.daddr;
+    telemetry_update();
+    print_telemetry();
+}
+
+// TinyUSB callback: USB-serial adapter unmounted
+void tuh_cdc_umount_cb(uint8_t idx) {
+    if (telemetry.mounted && idx == telemetry.cdc_idx) {
+        telemetry.mounted = false;
+        telemetry_update();
+        print_telemetry();
+    }
+}
+
+// Next pseudo-random number of the synthetic motion generator
+// (xorshift32), the sequence only depends on the seed
+static uint32_t synth_random(void) {
+    uint32_t x = synth_motion.rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    synth_motion.rng = x;
+    return x;
+}
+
+// Random value in -amplitude..amplitude
+static int8_t synth_random_delta(void) {
+    uint32_t span = 2u * synth_motion.amplitude + 1;
+    return (int8_t)((int32_t)(synth_random() % span) - synth_motion.amplitude);
+}
+
+// sin(2 pi i / 64) * 127
+static const int8_t synth_sin[64] = {
+    0, 12, 25, 37, 49, 60, 71, 81, 90, 98, 106, 112, 117, 122, 125, 126,
+    127, 126, 125, 122, 117, 112, 106, 98, 90, 81, 71, 60, 49, 37, 25, 12,
+    0, -12, -25, -37, -49, -60, -71, -81, -90, -98, -106, -112, -117, -122, -125, -126,
+    -127, -126, -125, -122, -117, -112, -106, -98, -90, -81, -71, -60, -49, -37, -25, -12
+};
+
+// Build the next synthetic report, returns false if none is sent
+static bool synth_next_report(uint8_t pattern, struct mouse_report *report) {
+    uint32_t step = synth_motion.step++;
+    *report = (struct mouse_report) { 0 };
+    switch (pattern) {
+        case SYNTH_CIRCLE:
+            // One turn per 64 reports, the table is symmetric so the
+            // circle closes exactly
+            report->x = (int8_t)(synth_sin[(step + 16) % 64] * synth_motion.amplitude / 127);
+            report->y = (int8_t)(synth_sin[step % 64] * synth_motion.amplitude / 127);
+            return true;
+        case SYNTH_SWIPE:
+            report->x = (step / RT_SYNTH_SWIPE_REPORTS) % 2 ? -127 : 127;
+            return true;
+        case SYNTH_JITTER:
+            report->x = synth_random_delta();
+            report->y = synth_random_delta();
+            return true;
+        case SYNTH_BUTTONS:
+            report->buttons = (uint8_t)(synth_random() & 0x07);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Restart the generator with the current settings, so that every run
+// produces the same sequence of reports
+void synth_restart() {
+    if (synth_motion.pattern != SYNTH_OFF && !synth_motion.mouse) {
+        synth_motion.mouse = attach_usb_mouse(RT_SYNTH_DEV_ADDR, 0);
+    } else if (synth_motion.pattern == SYNTH_OFF && synth_motion.mouse) {
+        detach_usb_mouse(synth_motion.mouse);
+        synth_motion.mouse = NULL;
+    }
+    synth_motion.rng = synth_motion.seed ? synth_motion.seed : 1;
+    synth_motion.step = 0;
+    synth_motion.reports = 0;
+    synth_motion.next_us = time_us_32();
+    synth_motion.phase_start_us = synth_motion.next_us;
+}
+
+// Inject synthetic reports at the configured rate, called from the main
+// loop.  If the loop was held up for more than one report period the
+// missed reports are skipped rather than sent in a burst.
+void poll_synth_motion() {
+    if (!synth_motion.mouse) {
+        return;
+    }
+    uint32_t now = time_us_32();
+    if ((int32_t)(now - synth_motion.next_us) < 0) {
+        return;
+    }
+    uint32_t period_us = 1000000 / synth_motion.rate_hz;
+    synth_motion.next_us += period_us;
+    if ((int32_t)(now - synth_motion.next_us) >= 0) {
+        synth_motion.next_us = now + period_us;
+    }
+    uint8_t pattern = synth_motion.pattern;
+    if (pattern == SYNTH_MIX) {
+        uint32_t phase = (now - synth_motion.phase_start_us) / (RT_SYNTH_MIX_PHASE_MS * 1000);
+        pattern = SYNTH_CIRCLE + phase % (SYNTH_MIX - SYNTH_CIRCLE);
+    }
+    struct mouse_report report;
+    if (synth_next_report(pattern, &report)) {
+        synth_motion.reports++;
+        handle_usb_mouse_report(synth_motion.mouse, &report);
+    }
+}
+
+// Keep reports flowing while the trace logger waits for the stick
+static void service_mouse_path(void) {
+    poll_synth_motion();
+    service_rt_pacer();
+    poll_rt_mouse_uart();
+}
+
 int main(void) {
+    debug_stats.boot_main_us = time_us_32();
+    init_cycle_counter();
+    // Bring up the RT side first: the RT may send RESET while the rest
+    // of the system is still initializing, and its driver only retries
+    // MS_MAX_RETRY times.  From here on commands are answered by the
+    // UART1 interrupt, concurrently with USB host bring-up.
+    init_rt_uart();
+    debug_stats.boot_rt_ready_us = time_us_32();
+
     stdio_init_all(); // UART0 for debug
     board_init();
     tuh_init(BOARD_TUH_RHPORT);
     board_init_after_tusb();
-    init_rt_uart();
+    debug_stats.boot_usb_ready_us = time_us_32();
+    synth_restart();
+    trace_log_init(service_mouse_path);
+    print_rt_uart_config();
     printf("pico-rt-mouse running\n");
+    print_debug_stats();
+    bool first_command_reported = false;
+    uint32_t loop_start_us = time_us_32();
     while (1) {
+        uint32_t now = time_us_32();
+        debug_stats.loop_max_us = max(debug_stats.loop_max_us, now - loop_start_us);
+        loop_start_us = now;
         tuh_task();
+        poll_usb_root_port();
+        poll_synth_motion();
+        service_rt_pacer();
         poll_rt_mouse_uart();
+        poll_debug_console();
+        poll_flight_recorder();
+        poll_telemetry();
+        trace_log_poll();
+        if (!first_command_reported && debug_stats.boot_first_response_us) {
+            first_command_reported = true;
+            print_debug_stats();
+        }
     }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#ifndef RT_ACCEL_HPP
+#define RT_ACCEL_HPP
+
+// Pointer acceleration.  A profile is a piecewise-linear curve of gain
+// over pointer speed, turned into a fixed-point lookup table at compile
+// time because the M0+ has no FPU.  Evaluating it costs one division
+// and one table load per USB report.
+//
+// Speed is in counts per millisecond, the table has a Q2 entry (quarter
+// counts) for every speed up to 63.75 counts/ms.  Gain is Q8, 256 = 1.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rt {
+
+constexpr size_t kAccelTableSize = 256;
+constexpr uint32_t kAccelUnityQ8 = 256;
+
+struct AccelPoint {
+    uint16_t speed;    // counts per millisecond
+    uint16_t gain_q8;
+};
+
+struct AccelTable {
+    uint16_t gain_q8[kAccelTableSize];
+};
+
+// Interpolate the curve at every table speed.  Points must be sorted by
+// speed, the gain of the first and last point extends to either end.
+template <size_t N>
+constexpr AccelTable make_accel_table(const AccelPoint (&points)[N]) {
+    AccelTable table = {};
+    for (size_t i = 0; i < kAccelTableSize; i++) {
+        int32_t speed_q2 = (int32_t)i;
+        size_t k = 0;
+        while (k < N && points[k].speed * 4 <= speed_q2) {
+            k++;
+        }
+        int32_t gain = 0;
+        if (k == 0) {
+            gain = points[0].gain_q8;
+        } else if (k == N) {
+            gain = points[N - 1].gain_q8;
+        } else {
+            int32_t x0 = points[k - 1].speed * 4;
+            int32_t x1 = points[k].speed * 4;
+            int32_t g0 = points[k - 1].gain_q8;
+            int32_t g1 = points[k].gain_q8;
+            gain = g0 + (g1 - g0) * (speed_q2 - x0) / (x1 - x0);
+        }
+        table.gain_q8[i] = (uint16_t)gain;
+    }
+    return table;
+}
+
+// Speed of a report in counts per millisecond, Q2.  The length of the
+// motion vector is approximated as max + min / 2, within 12%.
+constexpr uint32_t accel_speed_q2(int32_t dx, int32_t dy, uint32_t interval_us) {
+    uint32_t ax = (uint32_t)(dx < 0 ? -dx : dx);
+    uint32_t ay = (uint32_t)(dy < 0 ? -dy : dy);
+    uint32_t length = ax > ay ? ax + ay / 2 : ay + ax / 2;
+    return length * 4000 / (interval_us ? interval_us : 1000);
+}
+
+// Gain for one report, no table means exact linear motion
+constexpr uint32_t accel_gain_q8(const AccelTable *table, int32_t dx, int32_t dy, uint32_t interval_us) {
+    if (!table) {
+        return kAccelUnityQ8;
+    }
+    uint32_t speed_q2 = accel_speed_q2(dx, dy, interval_us);
+    return table->gain_q8[speed_q2 < kAccelTableSize ? speed_q2 : kAccelTableSize - 1];
+}
+
+// Built-in curves
+
+// Unchanged up to 4 counts/ms, then rising to double speed
+inline constexpr AccelPoint kMildCurve[] = {
+    { 0, 256 }, { 4, 256 }, { 16, 384 }, { 32, 512 },
+};
+
+// For high resolution mice: slow motion is halved for precise
+// positioning on the 1024x768 display, fast motion is still enough to
+// cross it with one sweep
+inline constexpr AccelPoint kHighDpiCurve[] = {
+    { 0, 128 }, { 2, 128 }, { 12, 256 }, { 32, 640 }, { 48, 768 },
+};
+
+inline constexpr AccelTable kMildTable = make_accel_table(kMildCurve);
+inline constexpr AccelTable kHighDpiTable = make_accel_table(kHighDpiCurve);
+
+// Spot checks of the table builder
+static_assert(kMildTable.gain_q8[0] == 256 && kMildTable.gain_q8[16] == 256);
+static_assert(kMildTable.gain_q8[40] == 320 && kMildTable.gain_q8[255] == 512);
+static_assert(kHighDpiTable.gain_q8[48] == 256);
+static_assert(accel_gain_q8(nullptr, 100, 100, 1000) == kAccelUnityQ8);
+
+} // namespace rt
+
+#endif // RT_ACCEL_HPP
@@ -0,0 +1,179 @@
+// Protocol engine instance used by the firmware.  The policies are
+// selected at build time:
+//
+//   RT_REPORT_FORMAT_PS2  send PS/2 3-byte data reports instead of RT
+//                         4-byte ones
+//   RT_FOLLOW_SCALING     apply the exponential curve when the RT selects
+//                         exponential scaling, otherwise motion is linear
+//   RT_BUTTON_MAP         0 = as on the USB mouse, 1 = left-handed,
+//                         2 = left and right together act as middle
+//
+// The pointer acceleration profile can be changed at run time, it starts
+// as RT_ACCEL_PROFILE.  RT_ACCEL_CURVE adds a profile built from the
+// given points, for example -DRT_ACCEL_CURVE="{0,256},{8,256},{24,640}"
+// (speed in counts per millisecond, gain in 1/256).
+
+#include <pico/stdlib.h>
+#include <hardware/timer.h>
+
+// The engine's hot functions are inlined into the __not_in_flash_func
+// wrappers at the end of this file, see RT_PROTOCOL_HOT
+#define RT_PROTOCOL_HOT __attribute__((always_inline))
+#define RT_PROTOCOL_HOT_DATA __not_in_flash("rt_protocol_data")
+#include "rt_protocol.hpp"
+#include "rt_accel.hpp"
+#include "rt_engine.h"
+
+#ifndef RT_REPORT_FORMAT_PS2
+#define RT_REPORT_FORMAT_PS2 0
+#endif
+
+#ifndef RT_FOLLOW_SCALING
+#define RT_FOLLOW_SCALING 0
+#endif
+
+#ifndef RT_BUTTON_MAP
+#define RT_BUTTON_MAP 0
+#endif
+
+#ifndef RT_ACCEL_PROFILE
+#define RT_ACCEL_PROFILE 0
+#endif
+
+// A command's parameter must follow within this time, otherwise the
+// command is dropped and the byte taken as a new command
+#define RT_CMD_TIMEOUT_US 20000
+
+namespace {
+
+struct UartTransport {
+    RT_PROTOCOL_HOT void send_response(const uint8_t *data, size_t len) {
+        send_response_uart(data, (uint32_t)len);
+    }
+
+    RT_PROTOCOL_HOT bool send_report(const uint8_t *data, size_t len) {
+        send_mouse_report_uart(data, (uint32_t)len);
+        return true;
+    }
+};
+
+struct TimerClock {
+    RT_PROTOCOL_HOT uint32_t now_us() const {
+        return time_us_32();
+    }
+};
+
+#if RT_FOLLOW_SCALING
+using Scaling = rt::RtSelectedScaling<rt::ExponentialCurve>;
+#else
+using Scaling = rt::LinearScaling;
+#endif
+
+#if RT_BUTTON_MAP == 1
+using Buttons = rt::LeftHandedButtonMap;
+#elif RT_BUTTON_MAP == 2
+using Buttons = rt::ChordMiddleButtonMap;
+#else
+using Buttons = rt::UsbButtonMap;
+#endif
+
+#if RT_REPORT_FORMAT_PS2
+using ReportFormat = rt::Ps2ReportFormat;
+#else
+using ReportFormat = rt::RtReportFormat;
+#endif
+
+using FirmwareEngine = rt::ProtocolEngine<UartTransport, TimerClock, Scaling,
+                                          rt::SampleRatePacing, Buttons, ReportFormat>;
+
+FirmwareEngine engine(UartTransport(), TimerClock(), RT_CMD_TIMEOUT_US);
+
+#ifdef RT_ACCEL_CURVE
+constexpr rt::AccelPoint custom_curve[] = { RT_ACCEL_CURVE };
+constexpr rt::AccelTable custom_table = rt::make_accel_table(custom_curve);
+#endif
+
+struct AccelProfile {
+    const char *name;
+    const rt::AccelTable *table;
+};
+
+constexpr AccelProfile accel_profiles[] = {
+    { "linear", nullptr },
+    { "mild", &rt::kMildTable },
+    { "high-dpi", &rt::kHighDpiTable },
+#ifdef RT_ACCEL_CURVE
+    { "custom", &custom_table },
+#endif
+};
+
+constexpr int accel_profile_count = sizeof(accel_profiles) / sizeof(accel_profiles[0]);
+
+static_assert(RT_ACCEL_PROFILE >= 0 && RT_ACCEL_PROFILE < accel_profile_count, "no such RT_ACCEL_PROFILE");
+
+int accel_profile = RT_ACCEL_PROFILE;
+const rt::AccelTable *accel_table = accel_profiles[RT_ACCEL_PROFILE].table;
+
+} // namespace
+
+extern "C" {
+
+uint32_t __not_in_flash_func(handle_rt_mouse_command)(uint8_t cmd) {
+    return engine.handle_byte(cmd);
+}
+
+void __not_in_flash_func(rt_engine_line_error)(void) {
+    engine.line_error();
+}
+
+uint32_t __not_in_flash_func(rt_engine_report_interval_us)(void) {
+    return engine.report_interval_us();
+}
+
+void __not_in_flash_func(send_rt_mouse_data)(uint8_t buttons, int32_t *dx, int32_t *dy) {
+    engine.send_report(buttons, *dx, *dy);
+}
+
+const struct MouseState *rt_mouse_state(void) {
+    return &engine.state();
+}
+
+const struct RtProtocolStats *rt_protocol_stats(void) {
+    return &engine.stats();
+}
+
+int rt_accel_profiles(void) {
+    return accel_profile_count;
+}
+
+const char *rt_accel_name(int profile) {
+    return profile >= 0 && profile < accel_profile_count ? accel_profiles[profile].name : "none";
+}
+
+int rt_accel_selected(void) {
+    return accel_profile;
+}
+
+void rt_accel_select(int profile) {
+    if (profile >= 0 && profile < accel_profile_count) {
+        accel_profile = profile;
+        accel_table = accel_profiles[profile].table;
+    }
+}
+
+uint32_t rt_accel_gain_q8(int32_t dx, int32_t dy, uint32_t interval_us) {
+    return rt::accel_gain_q8(accel_table, dx, dy, interval_us);
+}
+
+void rt_accel_scale(int32_t scale_q8, int8_t x, int8_t y, uint32_t interval_us,
+                    int16_t *frac_x, int16_t *frac_y, int32_t *dx, int32_t *dy) {
+    scale_q8 = scale_q8 * (int32_t)rt_accel_gain_q8(x, y, interval_us) >> 8;
+    int32_t sx = x * scale_q8 + *frac_x;
+    int32_t sy = y * scale_q8 + *frac_y;
+    *frac_x = (int16_t)(sx & 0xff);
+    *frac_y = (int16_t)(sy & 0xff);
+    *dx = sx >> 8;
+    *dy = sy >> 8;
+}
+
+}
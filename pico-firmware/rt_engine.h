@@ -0,0 +1,62 @@
+#ifndef RT_ENGINE_H
+#define RT_ENGINE_H
+
+// Interface between the C firmware and the protocol engine instance in
+// rt_engine.cpp
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rt_protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Implemented by rt_engine.cpp
+
+// Handle RT mouse protocol commands from host, returns RT_EVENT_* bits
+uint32_t handle_rt_mouse_command(uint8_t cmd);
+
+// Abandon a half-received command after a line error
+void rt_engine_line_error(void);
+
+// Minimum time between data reports
+uint32_t rt_engine_report_interval_us(void);
+
+// Translate USB boot protocol buttons and motion to a report and send it
+// over UART1, consuming as much of *dx and *dy as fits into the report
+void send_rt_mouse_data(uint8_t buttons, int32_t *dx, int32_t *dy);
+
+const struct MouseState *rt_mouse_state(void);
+const struct RtProtocolStats *rt_protocol_stats(void);
+
+// Pointer acceleration profiles, see rt_accel.hpp.  Profile 0 is exact
+// linear motion.
+int rt_accel_profiles(void);
+const char *rt_accel_name(int profile);
+int rt_accel_selected(void);
+void rt_accel_select(int profile);
+
+// Gain for one USB report of a mouse polled every interval_us, Q8
+uint32_t rt_accel_gain_q8(int32_t dx, int32_t dy, uint32_t interval_us);
+
+// Scale one USB report by scale_q8 and the selected profile's gain.  The
+// whole counts are returned in *dx and *dy, the fraction is carried in
+// *frac_x and *frac_y for the next report of the same mouse.
+void rt_accel_scale(int32_t scale_q8, int8_t x, int8_t y, uint32_t interval_us,
+                    int16_t *frac_x, int16_t *frac_y, int32_t *dx, int32_t *dy);
+
+// Implemented by the firmware, used as the engine's transport
+
+// Queue a response or wrap echo, called from the RX interrupt
+void send_response_uart(const uint8_t *response, uint32_t len);
+
+// Send a data report, waiting for room in the TX ring
+void send_mouse_report_uart(const uint8_t *report, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RT_ENGINE_H
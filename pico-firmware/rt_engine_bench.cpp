@@ -0,0 +1,186 @@
+// Protocol engine benchmark.  Prints the cycles taken to encode and hand
+// over one data report, and to handle one command byte, for a set of
+// policy combinations, and the cycles per USB report for each pointer
+// acceleration profile.  The image runs from SRAM so that the numbers
+// are not skewed by XIP cache misses.  Acceleration is timed through the
+// firmware's own rt_engine.cpp, which is linked in with the transport
+// below as a sink.
+
+#include <stdio.h>
+#include <pico/stdlib.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
+#include <hardware/structs/systick.h>
+
+#define RT_PROTOCOL_HOT __attribute__((always_inline))
+#define RT_PROTOCOL_HOT_DATA __not_in_flash("rt_protocol_data")
+#include "rt_protocol.hpp"
+#include "rt_engine.h"
+
+#define BENCH_ITERATIONS 1000
+
+namespace {
+
+// Transport that only keeps the last packet, so that the compiler
+// cannot drop the encoding
+struct NullTransport {
+    uint8_t last[4] = {};
+    size_t len = 0;
+
+    void send_response(const uint8_t *data, size_t n) {
+        copy(data, n);
+    }
+
+    bool send_report(const uint8_t *data, size_t n) {
+        copy(data, n);
+        return true;
+    }
+
+    void copy(const uint8_t *data, size_t n) {
+        for (len = 0; len < n && len < sizeof(last); len++) {
+            last[len] = data[len];
+        }
+    }
+};
+
+struct TimerClock {
+    uint32_t now_us() const {
+        return time_us_32();
+    }
+};
+
+inline uint32_t cycle_count() {
+    return systick_hw->cvr;
+}
+
+struct Result {
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+    uint32_t total = 0;
+
+    void add(uint32_t start) {
+        uint32_t cycles = (start - cycle_count()) & 0xffffff;
+        if (cycles < min) min = cycles;
+        if (cycles > max) max = cycles;
+        total += cycles;
+    }
+
+    void print(const char *name, const char *what) const {
+        printf("%-28s %-8s min %3lu, avg %3lu, max %3lu cycles\n", name, what,
+               (unsigned long)min, (unsigned long)(total / BENCH_ITERATIONS), (unsigned long)max);
+    }
+};
+
+template <class Engine>
+void __not_in_flash_func(bench)(const char *name, bool exponential) {
+    Engine engine;
+    engine.handle_byte(exponential ? MOUSE_CMD_SET_SCALE_EXP : MOUSE_CMD_SET_SCALE_LIN);
+
+    Result report;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        // Motion that needs clamping every other time
+        int32_t dx = (i & 1) ? 300 : -(i & 0x3f);
+        int32_t dy = (i & 2) ? -200 : (i & 0x1f);
+        uint8_t buttons = (uint8_t)(i & 0x07);
+        uint32_t save = save_and_disable_interrupts();
+        uint32_t start = cycle_count();
+        engine.send_report(buttons, dx, dy);
+        report.add(start);
+        restore_interrupts(save);
+    }
+    report.print(name, "report");
+
+    // READ_STATUS answers with a 4-byte response, SET_RATE is a command
+    // with a parameter
+    static const uint8_t commands[] = { MOUSE_CMD_READ_STATUS, MOUSE_CMD_SET_RATE, 100 };
+    Result command;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        uint8_t cmd = commands[i % sizeof(commands)];
+        uint32_t save = save_and_disable_interrupts();
+        uint32_t start = cycle_count();
+        engine.handle_byte(cmd);
+        command.add(start);
+        restore_interrupts(save);
+    }
+    command.print(name, "command");
+}
+
+// Keeps the accelerated motion alive
+volatile int32_t accel_sink;
+
+// Acceleration as merge_usb_mouse_motion() applies it, through the C
+// interface and the selected profile's table: gain lookup, scaling and
+// fractional carry of one USB report
+void __not_in_flash_func(bench_accel)(int profile) {
+    rt_accel_select(profile);
+    int16_t frac_x = 0;
+    int16_t frac_y = 0;
+    int32_t total = 0;
+    Result result;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        // Slow to fast motion at 1 kHz and 125 Hz polling
+        int8_t x = (int8_t)((i * 7) % 255 - 127);
+        int8_t y = (int8_t)((i * 3) % 64 - 32);
+        uint32_t interval_us = (i & 1) ? 1000 : 8000;
+        uint32_t save = save_and_disable_interrupts();
+        uint32_t start = cycle_count();
+        int32_t dx;
+        int32_t dy;
+        rt_accel_scale(256, x, y, interval_us, &frac_x, &frac_y, &dx, &dy);
+        result.add(start);
+        restore_interrupts(save);
+        total += dx + dy;
+    }
+    char name[40];
+    snprintf(name, sizeof(name), "Acceleration, %s", rt_accel_name(profile));
+    result.print(name, "accel");
+    accel_sink = total;
+}
+
+template <class Scaling, class Buttons, class Format>
+using BenchEngine = rt::ProtocolEngine<NullTransport, TimerClock, Scaling,
+                                       rt::SampleRatePacing, Buttons, Format>;
+
+} // namespace
+
+// Transport of the engine instance in rt_engine.cpp, which the benchmark
+// does not feed
+extern "C" {
+
+void send_response_uart(const uint8_t *response, uint32_t len) {
+}
+
+void send_mouse_report_uart(const uint8_t *report, uint32_t len) {
+}
+
+}
+
+int main(void) {
+    stdio_init_all();
+    systick_hw->rvr = 0xffffff;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+    sleep_ms(1000);
+
+    while (true) {
+        printf("\nProtocol engine, %d iterations each\n", BENCH_ITERATIONS);
+        bench<BenchEngine<rt::LinearScaling, rt::UsbButtonMap, rt::RtReportFormat>>(
+            "RT, linear", false);
+        bench<BenchEngine<rt::RtSelectedScaling<rt::ExponentialCurve>, rt::UsbButtonMap,
+                          rt::RtReportFormat>>("RT, RT-selected (linear)", false);
+        bench<BenchEngine<rt::RtSelectedScaling<rt::ExponentialCurve>, rt::UsbButtonMap,
+                          rt::RtReportFormat>>("RT, RT-selected (exp)", true);
+        bench<BenchEngine<rt::LinearScaling, rt::LeftHandedButtonMap, rt::RtReportFormat>>(
+            "RT, linear, left-handed", false);
+        bench<BenchEngine<rt::LinearScaling, rt::ChordMiddleButtonMap, rt::RtReportFormat>>(
+            "RT, linear, chord middle", false);
+        bench<BenchEngine<rt::LinearScaling, rt::UsbButtonMap, rt::Ps2ReportFormat>>(
+            "PS/2, linear", false);
+        bench<BenchEngine<rt::RtSelectedScaling<rt::ExponentialCurve>, rt::UsbButtonMap,
+                          rt::Ps2ReportFormat>>("PS/2, RT-selected (exp)", true);
+        for (int profile = 0; profile < rt_accel_profiles(); profile++) {
+            bench_accel(profile);
+        }
+        sleep_ms(10000);
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef RT_PROTOCOL_H
+#define RT_PROTOCOL_H
+
+// RT mouse protocol definitions shared between the firmware (C), the
+// protocol engine in rt_protocol.hpp and host-side tools
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// RT mouse protocol constants
+#define RT_MOUSE_DATA_REPORT 0x0b
+#define RT_MOUSE_STATUS_REPORT 0x61
+#define RT_MOUSE_RESET_ACK 0xff
+#define RT_MOUSE_CONFIGURED 0x20
+
+// RT mouse protocol commands
+#define MOUSE_CMD_RESET 0x01
+#define MOUSE_CMD_READ_CONFIG 0x06
+#define MOUSE_CMD_ENABLE 0x08
+#define MOUSE_CMD_DISABLE 0x09
+#define MOUSE_CMD_READ_DATA 0x0b
+#define MOUSE_CMD_WRAP_ON 0x0e
+#define MOUSE_CMD_WRAP_OFF 0x0f
+#define MOUSE_CMD_SET_SCALE_EXP 0x78
+#define MOUSE_CMD_SET_SCALE_LIN 0x6c
+#define MOUSE_CMD_READ_STATUS 0x73
+#define MOUSE_CMD_SET_RATE 0x8a
+#define MOUSE_CMD_SET_MODE 0x8d
+#define MOUSE_CMD_SET_RESOLUTION 0x89
+
+// Mouse state
+struct MouseState {
+    bool initialized;
+    uint8_t last_command;
+    bool enabled;
+    bool wrap_mode;
+    char scaling; // 'l' = linear, 'e' = exponential
+    uint8_t resolution;
+    uint8_t sample_rate;
+    char mode; // 's' = stream, 'r' = remote
+    bool left_button;
+    bool middle_button;
+    bool right_button;
+};
+
+// Counters kept by the protocol engine
+struct RtProtocolStats {
+    uint32_t wrap_echoes;           // bytes echoed in wrap mode
+    uint32_t cmd_unknown;           // bytes that are neither command nor expected parameter
+    uint32_t cmd_bad_params;        // invalid parameter, parser resynchronized
+    uint32_t cmd_timeouts;          // parameter did not arrive in time
+    uint32_t cmd_discarded;         // half-received commands dropped on line errors
+    uint32_t line_error_us;         // time of the last line error
+    bool recovery_pending_done;
+    uint32_t recovery_us;           // last line error to next complete command
+    uint32_t recovery_max_us;
+};
+
+// Events returned by the command handler for the caller to act upon
+#define RT_EVENT_RESET 0x01     // pending motion must be dropped
+#define RT_EVENT_ENABLE 0x02
+#define RT_EVENT_DISABLE 0x04   // pending motion must be dropped
+#define RT_EVENT_READ_DATA 0x08 // a data report must be sent now
+
+// Mouse buttons as used between the button map and the report format,
+// same bits as a USB boot protocol mouse report
+#define RT_BUTTON_LEFT 0x01
+#define RT_BUTTON_RIGHT 0x02
+#define RT_BUTTON_MIDDLE 0x04
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RT_PROTOCOL_H
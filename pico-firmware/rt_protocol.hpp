@@ -0,0 +1,437 @@
+#ifndef RT_PROTOCOL_HPP
+#define RT_PROTOCOL_HPP
+
+// RT mouse protocol engine
+//
+// The engine is a class template parameterized by policy types, so that
+// every build configuration compiles to straight-line code without
+// runtime checks for options that it does not use:
+//
+//   Transport  send_response(data, len): responses and wrap echoes,
+//              must not block
+//              send_report(data, len): data reports, returns false if
+//              the report could not be sent
+//   Clock      now_us(): free-running 32-bit microsecond counter
+//   Scaling    apply(delta, state): motion curve for one axis
+//              max_input(max_output, state): largest delta whose
+//              scaled magnitude is at most max_output
+//   Pacing     interval_us(state): minimum time between data reports
+//   Buttons    map(usb_buttons): USB boot protocol buttons to RT_BUTTON_*
+//   Format     size, max_delta and encode(out, buttons, x, y): wire
+//              format of a data report, y positive is up
+//
+// Policies are held by value, stateless ones cost nothing.  The engine
+// has no dependencies on the Pico SDK and is also used by the host
+// tools.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "rt_protocol.h"
+
+// Attributes for the engine's hot functions and the command table,
+// everything reached from handle_byte() runs in the RX interrupt.  GCC
+// ignores section attributes on members of class templates, so the
+// firmware forces the hot functions inline into its SRAM wrappers and
+// only places the table, which is not a template member, by section.
+#ifndef RT_PROTOCOL_HOT
+#define RT_PROTOCOL_HOT
+#endif
+#ifndef RT_PROTOCOL_HOT_DATA
+#define RT_PROTOCOL_HOT_DATA
+#endif
+
+namespace rt {
+
+constexpr uint32_t kDefaultCommandTimeoutUs = 20000;
+
+RT_PROTOCOL_HOT constexpr int32_t clamp(int32_t value, int32_t low, int32_t high) {
+    return value < low ? low : value > high ? high : value;
+}
+
+// Scaling policies
+
+// Motion is passed through, the RT's scaling setting is ignored
+struct LinearScaling {
+    RT_PROTOCOL_HOT static constexpr int32_t apply(int32_t delta, const MouseState &) {
+        return delta;
+    }
+
+    RT_PROTOCOL_HOT static constexpr int32_t max_input(int32_t max_output, const MouseState &) {
+        return max_output;
+    }
+};
+
+// 2:1 exponential curve of the PS/2 family mice: small movements stay
+// exact, fast ones are doubled
+struct ExponentialCurve {
+    RT_PROTOCOL_HOT static constexpr int32_t apply(int32_t delta) {
+        int32_t magnitude = delta < 0 ? -delta : delta;
+        int32_t scaled = magnitude < 6 ? kTable[magnitude] : 2 * magnitude;
+        return delta < 0 ? -scaled : scaled;
+    }
+
+    RT_PROTOCOL_HOT static constexpr int32_t max_input(int32_t max_output) {
+        if (max_output >= 12) {
+            return max_output / 2;
+        }
+        int32_t magnitude = 0;
+        while (magnitude < 5 && kTable[magnitude + 1] <= max_output) {
+            magnitude++;
+        }
+        return magnitude;
+    }
+
+    static constexpr int32_t kTable[6] RT_PROTOCOL_HOT_DATA = { 0, 1, 1, 3, 6, 9 };
+};
+
+// Follows SET_SCALE_EXP/SET_SCALE_LIN from the RT, using Curve when the
+// RT selected exponential scaling
+template <class Curve>
+struct RtSelectedScaling {
+    RT_PROTOCOL_HOT static constexpr int32_t apply(int32_t delta, const MouseState &state) {
+        return state.scaling == 'e' ? Curve::apply(delta) : delta;
+    }
+
+    RT_PROTOCOL_HOT static constexpr int32_t max_input(int32_t max_output, const MouseState &state) {
+        return state.scaling == 'e' ? Curve::max_input(max_output) : max_output;
+    }
+};
+
+// Pacing policies
+
+// At most one report per sample period as set with SET_RATE
+struct SampleRatePacing {
+    RT_PROTOCOL_HOT static constexpr uint32_t interval_us(const MouseState &state) {
+        return 1000000 / (state.sample_rate ? state.sample_rate : 100);
+    }
+};
+
+// Reports are sent as fast as the transport takes them
+struct UnpacedPacing {
+    RT_PROTOCOL_HOT static constexpr uint32_t interval_us(const MouseState &) {
+        return 0;
+    }
+};
+
+// Button mapping policies
+
+struct UsbButtonMap {
+    RT_PROTOCOL_HOT static constexpr uint8_t map(uint8_t usb_buttons) {
+        return usb_buttons & (RT_BUTTON_LEFT | RT_BUTTON_RIGHT | RT_BUTTON_MIDDLE);
+    }
+};
+
+// Left and right swapped
+struct LeftHandedButtonMap {
+    RT_PROTOCOL_HOT static constexpr uint8_t map(uint8_t usb_buttons) {
+        return (usb_buttons & RT_BUTTON_LEFT ? RT_BUTTON_RIGHT : 0) |
+               (usb_buttons & RT_BUTTON_RIGHT ? RT_BUTTON_LEFT : 0) |
+               (usb_buttons & RT_BUTTON_MIDDLE);
+    }
+};
+
+// Left and right pressed together act as the middle button, for two
+// button mice
+struct ChordMiddleButtonMap {
+    RT_PROTOCOL_HOT static constexpr uint8_t map(uint8_t usb_buttons) {
+        uint8_t buttons = UsbButtonMap::map(usb_buttons);
+        constexpr uint8_t chord = RT_BUTTON_LEFT | RT_BUTTON_RIGHT;
+        return (buttons & chord) == chord ? (uint8_t)((buttons & ~chord) | RT_BUTTON_MIDDLE) : buttons;
+    }
+};
+
+// Report format policies
+
+// RT PC 4-byte data report, see mouse_rt in mouseio.h
+struct RtReportFormat {
+    static constexpr size_t size = 4;
+    static constexpr int32_t max_delta = 127;
+
+    RT_PROTOCOL_HOT static size_t encode(uint8_t *out, uint8_t buttons, int32_t x, int32_t y) {
+        uint8_t status = 0;
+        if (buttons & RT_BUTTON_LEFT) status |= 0x20;
+        if (buttons & RT_BUTTON_RIGHT) status |= 0x80;
+        if (buttons & RT_BUTTON_MIDDLE) status |= 0x40;
+        x = clamp(x, -max_delta, max_delta);
+        y = clamp(y, -max_delta, max_delta);
+        if (x < 0) status |= 0x04;
+        if (y < 0) status |= 0x02;
+        out[0] = RT_MOUSE_DATA_REPORT;
+        out[1] = status;
+        out[2] = (uint8_t)x;
+        out[3] = (uint8_t)y;
+        return size;
+    }
+};
+
+// PS/2 3-byte data report, see mouse_atr in mouseio.h
+struct Ps2ReportFormat {
+    static constexpr size_t size = 3;
+    static constexpr int32_t max_delta = 255;
+
+    RT_PROTOCOL_HOT static size_t encode(uint8_t *out, uint8_t buttons, int32_t x, int32_t y) {
+        uint8_t status = 0x08;
+        if (buttons & RT_BUTTON_LEFT) status |= 0x01;
+        if (buttons & RT_BUTTON_RIGHT) status |= 0x02;
+        if (buttons & RT_BUTTON_MIDDLE) status |= 0x04;
+        if (x < -max_delta || x > max_delta) status |= 0x40;
+        if (y < -max_delta || y > max_delta) status |= 0x80;
+        x = clamp(x, -max_delta, max_delta);
+        y = clamp(y, -max_delta, max_delta);
+        if (x < 0) status |= 0x10;
+        if (y < 0) status |= 0x20;
+        out[0] = status;
+        out[1] = (uint8_t)x;
+        out[2] = (uint8_t)y;
+        return size;
+    }
+};
+
+// Commands and their parameter checks, shared by all engine instances
+enum class ParamCheck : uint8_t { None, Rate, Mode, Resolution };
+
+struct Command {
+    uint8_t cmd;
+    uint8_t arity;
+    ParamCheck check;
+};
+
+// RT mouse commands with their number of parameter bytes
+inline constexpr Command kCommands[] RT_PROTOCOL_HOT_DATA = {
+    { MOUSE_CMD_RESET, 0, ParamCheck::None },
+    { MOUSE_CMD_READ_CONFIG, 0, ParamCheck::None },
+    { MOUSE_CMD_ENABLE, 0, ParamCheck::None },
+    { MOUSE_CMD_DISABLE, 0, ParamCheck::None },
+    { MOUSE_CMD_READ_DATA, 0, ParamCheck::None },
+    { MOUSE_CMD_WRAP_ON, 0, ParamCheck::None },
+    { MOUSE_CMD_WRAP_OFF, 0, ParamCheck::None },
+    { MOUSE_CMD_SET_SCALE_EXP, 0, ParamCheck::None },
+    { MOUSE_CMD_SET_SCALE_LIN, 0, ParamCheck::None },
+    { MOUSE_CMD_READ_STATUS, 0, ParamCheck::None },
+    { MOUSE_CMD_SET_RATE, 1, ParamCheck::Rate },
+    { MOUSE_CMD_SET_MODE, 1, ParamCheck::Mode },
+    { MOUSE_CMD_SET_RESOLUTION, 1, ParamCheck::Resolution },
+};
+
+template <class Transport, class Clock, class Scaling, class Pacing, class Buttons, class Format>
+class ProtocolEngine {
+public:
+    constexpr explicit ProtocolEngine(Transport transport = Transport(), Clock clock = Clock(),
+                            uint32_t command_timeout_us = kDefaultCommandTimeoutUs)
+        : transport_(transport), clock_(clock), command_timeout_us_(command_timeout_us) {}
+
+    MouseState &state() { return state_; }
+    const MouseState &state() const { return state_; }
+    const RtProtocolStats &stats() const { return stats_; }
+    Transport &transport() { return transport_; }
+
+    // Handle one byte received from the RT, returns RT_EVENT_* bits.
+    // In wrap mode everything but WRAP_OFF and RESET is echoed back
+    // without being interpreted.  Commands with parameters stay pending
+    // until the parameter arrived, a parameter that is out of range or
+    // late is taken as the start of a new command instead.
+    RT_PROTOCOL_HOT uint32_t handle_byte(uint8_t byte) {
+        if (state_.wrap_mode && byte != MOUSE_CMD_WRAP_OFF && byte != MOUSE_CMD_RESET) {
+            transport_.send_response(&byte, 1);
+            stats_.wrap_echoes++;
+            return 0;
+        }
+        uint32_t now = clock_.now_us();
+        if (pending_ && now - last_byte_us_ > command_timeout_us_) {
+            // The parameter never came.  The command is dropped for good,
+            // not just for this byte, so a byte after an unknown one is
+            // not taken as its parameter either.
+            stats_.cmd_timeouts++;
+            pending_ = nullptr;
+        }
+        last_byte_us_ = now;
+        if (pending_) {
+            const Command &command = *pending_;
+            if (valid_param(command.check, byte)) {
+                params_[param_count_++] = byte;
+                return param_count_ == command.arity ? execute(command, now) : 0;
+            }
+            stats_.cmd_bad_params++;
+            pending_ = nullptr;
+        }
+        const Command *command = find_command(byte);
+        if (!command) {
+            stats_.cmd_unknown++;
+            return 0;
+        }
+        if (command->arity) {
+            pending_ = command;
+            param_count_ = 0;
+            return 0;
+        }
+        return execute(*command, now);
+    }
+
+    // A character was lost or corrupted on the line: abandon any
+    // half-received command
+    RT_PROTOCOL_HOT void line_error() {
+        if (pending_) {
+            stats_.cmd_discarded++;
+            pending_ = nullptr;
+        }
+        stats_.line_error_us = clock_.now_us();
+        stats_.recovery_pending_done = false;
+    }
+
+    // Minimum time between two data reports
+    RT_PROTOCOL_HOT uint32_t report_interval_us() const {
+        return Pacing::interval_us(state_);
+    }
+
+    // Encode a data report from USB boot protocol buttons and motion
+    // (y positive is down), taking as much of dx/dy as fits into one
+    // report once scaled and leaving the rest, unscaled, for the next.
+    RT_PROTOCOL_HOT size_t encode_report(uint8_t *out, uint8_t usb_buttons, int32_t &dx, int32_t &dy) const {
+        int32_t limit = Scaling::max_input(Format::max_delta, state_);
+        int32_t x = clamp(dx, -limit, limit);
+        int32_t y = clamp(dy, -limit, limit);
+        dx -= x;
+        dy -= y;
+        return Format::encode(out, Buttons::map(usb_buttons),
+                              Scaling::apply(x, state_), -Scaling::apply(y, state_));
+    }
+
+    // Encode a data report and hand it to the transport.  Motion is
+    // only consumed if the transport took the report.
+    RT_PROTOCOL_HOT bool send_report(uint8_t usb_buttons, int32_t &dx, int32_t &dy) {
+        uint8_t out[Format::size];
+        int32_t x = dx;
+        int32_t y = dy;
+        size_t len = encode_report(out, usb_buttons, x, y);
+        if (!transport_.send_report(out, len)) {
+            return false;
+        }
+        dx = x;
+        dy = y;
+        return true;
+    }
+
+private:
+    static constexpr size_t kMaxParams = 1;
+
+    RT_PROTOCOL_HOT static const Command *find_command(uint8_t cmd) {
+        for (const Command &command : kCommands) {
+            if (command.cmd == cmd) {
+                return &command;
+            }
+        }
+        return nullptr;
+    }
+
+    // Parameter checks, see the SAMPLE RATE and SET RESOLUTION charts and
+    // the mode values in mouseio.h.  Rate 200 is used by the ATR driver.
+    RT_PROTOCOL_HOT static bool valid_param(ParamCheck check, uint8_t param) {
+        switch (check) {
+            case ParamCheck::Rate:
+                return param == 10 || param == 20 || param == 40 || param == 60 ||
+                       param == 80 || param == 100 || param == 200;
+            case ParamCheck::Mode:
+                return param == 0x00 || param == 0x03;
+            case ParamCheck::Resolution:
+                return param <= 0x03;
+            default:
+                return true;
+        }
+    }
+
+    RT_PROTOCOL_HOT void send_status_report() {
+        uint8_t status[4] = {
+            RT_MOUSE_STATUS_REPORT,
+            (uint8_t)((state_.enabled ? 0x00 : 0x20) |
+                      (state_.scaling == 'e' ? 0x10 : 0x00) |
+                      (state_.mode == 'r' ? 0x08 : 0x00) |
+                      0x04),
+            state_.resolution,
+            state_.sample_rate
+        };
+        transport_.send_response(status, sizeof(status));
+    }
+
+    RT_PROTOCOL_HOT uint32_t execute(const Command &command, uint32_t now) {
+        pending_ = nullptr;
+        uint32_t events = 0;
+        switch (command.cmd) {
+            case MOUSE_CMD_RESET: {
+                const uint8_t ack[4] = { RT_MOUSE_RESET_ACK, 0x08, 0x00, 0x00 };
+                transport_.send_response(ack, sizeof(ack));
+                state_.initialized = false;
+                state_.wrap_mode = false;
+                state_.enabled = true;
+                events = RT_EVENT_RESET;
+                break;
+            }
+            case MOUSE_CMD_READ_CONFIG: {
+                const uint8_t conf[4] = { RT_MOUSE_CONFIGURED, 0x00, 0x00, 0x00 };
+                transport_.send_response(conf, sizeof(conf));
+                state_.initialized = true;
+                break;
+            }
+            case MOUSE_CMD_ENABLE:
+                state_.enabled = true;
+                events = RT_EVENT_ENABLE;
+                break;
+            case MOUSE_CMD_DISABLE:
+                state_.enabled = false;
+                events = RT_EVENT_DISABLE;
+                break;
+            case MOUSE_CMD_READ_DATA:
+                events = RT_EVENT_READ_DATA;
+                break;
+            case MOUSE_CMD_WRAP_ON:
+                state_.wrap_mode = true;
+                break;
+            case MOUSE_CMD_WRAP_OFF:
+                state_.wrap_mode = false;
+                break;
+            case MOUSE_CMD_SET_SCALE_EXP:
+                state_.scaling = 'e';
+                break;
+            case MOUSE_CMD_SET_SCALE_LIN:
+                state_.scaling = 'l';
+                break;
+            case MOUSE_CMD_READ_STATUS:
+                send_status_report();
+                break;
+            case MOUSE_CMD_SET_RATE:
+                state_.sample_rate = params_[0];
+                break;
+            case MOUSE_CMD_SET_MODE:
+                state_.mode = (params_[0] == 0x03) ? 'r' : 's';
+                break;
+            case MOUSE_CMD_SET_RESOLUTION:
+                state_.resolution = params_[0];
+                break;
+        }
+        state_.last_command = command.cmd;
+        if (stats_.line_error_us && !stats_.recovery_pending_done) {
+            stats_.recovery_us = now - stats_.line_error_us;
+            if (stats_.recovery_us > stats_.recovery_max_us) {
+                stats_.recovery_max_us = stats_.recovery_us;
+            }
+            stats_.recovery_pending_done = true;
+        }
+        return events;
+    }
+
+    Transport transport_;
+    Clock clock_;
+    uint32_t command_timeout_us_;
+    // initialized, last_command, enabled, wrap_mode, scaling, resolution,
+    // sample_rate, mode, left_button, middle_button, right_button
+    MouseState state_ = { false, 0, true, false, 'l', 100, 100, 's', false, false, false };
+    RtProtocolStats stats_ = {};
+    const Command *pending_ = nullptr;
+    uint8_t params_[kMaxParams] = {};
+    uint8_t param_count_ = 0;
+    uint32_t last_byte_us_ = 0;
+};
+
+} // namespace rt
+
+#endif // RT_PROTOCOL_HPP
@@ -0,0 +1,93 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+// Telemetry stream format, shared between the firmware and the
+// rt-telemetry host tool.  The firmware streams every flight recorder
+// event to a USB-serial adapter as one record:
+//
+//   seq (u8), time_us (u32 le), type (u8), data
+//
+// Each record is COBS encoded and followed by a 0x00 delimiter, so a
+// receiver that starts listening mid-stream resynchronizes on the next
+// record.  seq counts records and shows frames lost on the way; events
+// the firmware could not queue are reported with FR_EVENT_DROPPED.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "flight_recorder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TM_RECORD_MAX (6 + sizeof(((struct FlightEvent *)0)->data))
+#define TM_FRAME_MAX (TM_RECORD_MAX + 2)   // COBS overhead byte and delimiter
+
+// COBS-encode len (< 254) bytes and append the delimiter, returns the
+// frame length
+static inline size_t tm_cobs_encode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t code_pos = 0;
+    size_t pos = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (in[i]) {
+            out[pos++] = in[i];
+            code++;
+        } else {
+            out[code_pos] = code;
+            code_pos = pos++;
+            code = 1;
+        }
+    }
+    out[code_pos] = code;
+    out[pos++] = 0;
+    return pos;
+}
+
+// Decode a frame without its delimiter, returns the record length or
+// 0 if the frame is malformed or longer than out_size
+static inline size_t tm_cobs_decode(const uint8_t *in, size_t len, uint8_t *out, size_t out_size) {
+    size_t pos = 0;
+    size_t i = 0;
+    while (i < len) {
+        uint8_t code = in[i++];
+        if (!code || i + code - 1 > len || pos + code - 1 > out_size) {
+            return 0;
+        }
+        for (uint8_t j = 1; j < code; j++) {
+            if (!in[i]) {
+                return 0;
+            }
+            out[pos++] = in[i++];
+        }
+        if (i < len) {
+            if (pos == out_size) {
+                return 0;
+            }
+            out[pos++] = 0;
+        }
+    }
+    return pos;
+}
+
+// Build the frame of one event, returns its length
+static inline size_t tm_encode_event(uint8_t seq, const struct FlightEvent *event, uint8_t *frame) {
+    uint8_t record[TM_RECORD_MAX];
+    record[0] = seq;
+    record[1] = (uint8_t)event->time_us;
+    record[2] = (uint8_t)(event->time_us >> 8);
+    record[3] = (uint8_t)(event->time_us >> 16);
+    record[4] = (uint8_t)(event->time_us >> 24);
+    record[5] = event->type;
+    for (uint8_t i = 0; i < event->len; i++) {
+        record[6 + i] = event->data[i];
+    }
+    return tm_cobs_encode(record, 6 + event->len, frame);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_H
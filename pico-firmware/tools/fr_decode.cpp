@@ -0,0 +1,150 @@
+#include "fr_decode.hpp"
+
+#include <cstdio>
+
+#include "flight_recorder.h"
+#include "rt_protocol.h"
+
+namespace {
+
+const char *const trigger_names[FR_TRIGGERS] = FR_TRIGGER_NAMES;
+
+const char *command_name(uint8_t cmd) {
+    switch (cmd) {
+        case MOUSE_CMD_RESET: return "RESET";
+        case MOUSE_CMD_READ_CONFIG: return "READ_CONFIG";
+        case MOUSE_CMD_ENABLE: return "ENABLE";
+        case MOUSE_CMD_DISABLE: return "DISABLE";
+        case MOUSE_CMD_READ_DATA: return "READ_DATA";
+        case MOUSE_CMD_WRAP_ON: return "WRAP_ON";
+        case MOUSE_CMD_WRAP_OFF: return "WRAP_OFF";
+        case MOUSE_CMD_SET_SCALE_EXP: return "SET_SCALE_EXP";
+        case MOUSE_CMD_SET_SCALE_LIN: return "SET_SCALE_LIN";
+        case MOUSE_CMD_READ_STATUS: return "READ_STATUS";
+        case MOUSE_CMD_SET_RATE: return "SET_RATE";
+        case MOUSE_CMD_SET_MODE: return "SET_MODE";
+        case MOUSE_CMD_SET_RESOLUTION: return "SET_RESOLUTION";
+        default: return nullptr;
+    }
+}
+
+bool command_has_param(uint8_t cmd) {
+    return cmd == MOUSE_CMD_SET_RATE || cmd == MOUSE_CMD_SET_MODE || cmd == MOUSE_CMD_SET_RESOLUTION;
+}
+
+// Buttons as L, M and R, or - when released
+std::string buttons(bool left, bool middle, bool right) {
+    return std::string(left ? "L" : "-") + (middle ? "M" : "-") + (right ? "R" : "-");
+}
+
+} // namespace
+
+std::string hex(const std::vector<uint8_t> &data) {
+    std::string out;
+    char buf[4];
+    for (uint8_t byte : data) {
+        snprintf(buf, sizeof(buf), "%s%02x", out.empty() ? "" : " ", byte);
+        out += buf;
+    }
+    return out;
+}
+
+std::string EventDecoder::describe(const Event &event) {
+    const std::vector<uint8_t> &d = event.data;
+    char buf[128];
+    switch (event.type) {
+        case FR_EVENT_USB_REPORT:
+            if (d.size() < 4) break;
+            snprintf(buf, sizeof(buf), "USB      mouse %d  %s  x %+4d  y %+4d", d[0],
+                     buttons(d[1] & 0x01, d[1] & 0x04, d[1] & 0x02).c_str(), (int8_t)d[2], (int8_t)d[3]);
+            return buf;
+        case FR_EVENT_RT_RX:
+            if (d.size() < 1) break;
+            return "RT RX    " + describe_command(d[0]);
+        case FR_EVENT_RT_TX:
+            return "RT TX    " + describe_packet(d);
+        case FR_EVENT_LINE_ERROR:
+            if (d.size() < 2) break;
+            snprintf(buf, sizeof(buf), "LINE     %s%s%s%serror, byte %02x",
+                     d[0] & 0x01 ? "framing " : "", d[0] & 0x02 ? "parity " : "",
+                     d[0] & 0x04 ? "break " : "", d[0] & 0x08 ? "overrun " : "", d[1]);
+            param_for_ = 0;
+            return buf;
+        case FR_EVENT_USB_ATTACH:
+        case FR_EVENT_USB_DETACH:
+            if (d.size() < 3) break;
+            snprintf(buf, sizeof(buf), "USB      mouse %d %s, dev_addr %d instance %d", d[0],
+                     event.type == FR_EVENT_USB_ATTACH ? "attached" : "detached", d[1], d[2]);
+            return buf;
+        case FR_EVENT_TRIGGER:
+            if (d.size() < 1) break;
+            return std::string("TRIGGER  ") + (d[0] < FR_TRIGGERS ? trigger_names[d[0]] : "unknown");
+        case FR_EVENT_PACER:
+            if (d.size() < 6) break;
+            snprintf(buf, sizeof(buf), "PACER    data age %u/%u us, TX ring %u bytes, carried over %u",
+                     d[0] | d[1] << 8, d[2] | d[3] << 8, d[4], d[5]);
+            return buf;
+        case FR_EVENT_DROPPED:
+            if (d.size() < 2) break;
+            snprintf(buf, sizeof(buf), "DROPPED  %u events", d[0] | d[1] << 8);
+            return buf;
+    }
+    snprintf(buf, sizeof(buf), "type %02x  %s", event.type, hex(d).c_str());
+    return buf;
+}
+
+// RX bytes are decoded the way the firmware's parser sees them,
+// except that the parameter checks are not repeated
+std::string EventDecoder::describe_command(uint8_t byte) {
+    char buf[64];
+    if (wrap_ && byte != MOUSE_CMD_WRAP_OFF && byte != MOUSE_CMD_RESET) {
+        snprintf(buf, sizeof(buf), "%02x (wrap)", byte);
+        return buf;
+    }
+    if (param_for_) {
+        snprintf(buf, sizeof(buf), "%02x (%s parameter, %d)", byte, command_name(param_for_), byte);
+        param_for_ = 0;
+        return buf;
+    }
+    const char *name = command_name(byte);
+    if (!name) {
+        snprintf(buf, sizeof(buf), "%02x (unknown)", byte);
+        return buf;
+    }
+    if (command_has_param(byte)) {
+        param_for_ = byte;
+    }
+    if (byte == MOUSE_CMD_WRAP_ON) {
+        wrap_ = true;
+    } else if (byte == MOUSE_CMD_WRAP_OFF || byte == MOUSE_CMD_RESET) {
+        wrap_ = false;
+    }
+    snprintf(buf, sizeof(buf), "%02x %s", byte, name);
+    return buf;
+}
+
+std::string EventDecoder::describe_packet(const std::vector<uint8_t> &d) {
+    char buf[96];
+    std::string raw = hex(d);
+    if (d.size() == 4 && d[0] == RT_MOUSE_DATA_REPORT) {
+        snprintf(buf, sizeof(buf), "%s  report %s  x %+4d  y %+4d", raw.c_str(),
+                 buttons(d[1] & 0x20, d[1] & 0x40, d[1] & 0x80).c_str(), (int8_t)d[2], (int8_t)d[3]);
+    } else if (d.size() == 4 && d[0] == RT_MOUSE_RESET_ACK) {
+        snprintf(buf, sizeof(buf), "%s  reset ack", raw.c_str());
+    } else if (d.size() == 4 && d[0] == RT_MOUSE_CONFIGURED) {
+        snprintf(buf, sizeof(buf), "%s  configured", raw.c_str());
+    } else if (d.size() == 4 && d[0] == RT_MOUSE_STATUS_REPORT) {
+        snprintf(buf, sizeof(buf), "%s  status, resolution %d, rate %d", raw.c_str(), d[2], d[3]);
+    } else if (d.size() == 3) {
+        int x = (d[0] & 0x10) ? d[1] - 256 : d[1];
+        int y = (d[0] & 0x20) ? d[2] - 256 : d[2];
+        snprintf(buf, sizeof(buf), "%s  PS/2 report %s  x %+4d  y %+4d", raw.c_str(),
+                 buttons(d[0] & 0x01, d[0] & 0x04, d[0] & 0x02).c_str(), x, y);
+    } else if (d.size() == 1) {
+        snprintf(buf, sizeof(buf), "%s  echo", raw.c_str());
+    } else {
+        return raw;
+    }
+    return buf;
+}
+
@@ -0,0 +1,40 @@
+#ifndef FR_DECODE_HPP
+#define FR_DECODE_HPP
+
+// Human-readable flight recorder events, shared by rt-flight (dumps on
+// the debug console), rt-telemetry (the live stream) and rt-trace
+// (trace files from a USB stick)
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Event {
+    uint32_t time_us;
+    uint8_t type;
+    std::vector<uint8_t> data;
+};
+
+// Bytes as "0b 00 7f 0a"
+std::string hex(const std::vector<uint8_t> &data);
+
+// Describes events in the order they were recorded.  RX bytes depend on
+// the ones before, which is kept until reset().
+class EventDecoder {
+public:
+    std::string describe(const Event &event);
+
+    void reset() {
+        param_for_ = 0;
+        wrap_ = false;
+    }
+
+private:
+    std::string describe_command(uint8_t byte);
+    static std::string describe_packet(const std::vector<uint8_t> &d);
+
+    uint8_t param_for_ = 0;
+    bool wrap_ = false;
+};
+
+#endif // FR_DECODE_HPP
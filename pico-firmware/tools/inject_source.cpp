@@ -0,0 +1,82 @@
+#include "inject_source.hpp"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+std::unique_ptr<InjectSource> InjectSource::create(const char *name, std::string &error) {
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0660);
+    if (fd < 0 || ftruncate(fd, sizeof(RtInjectRing)) < 0) {
+        error = std::string(name) + ": " + strerror(errno);
+        if (fd >= 0) close(fd);
+        return nullptr;
+    }
+    void *map = mmap(nullptr, sizeof(RtInjectRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        error = std::string(name) + ": " + strerror(errno);
+        return nullptr;
+    }
+
+    int doorbell = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    int len = rt_inject_doorbell_address(name, addr.sun_path, (int)sizeof(addr.sun_path));
+    if (doorbell < 0 || bind(doorbell, (struct sockaddr *)&addr,
+                             (socklen_t)(offsetof(struct sockaddr_un, sun_path) + len)) < 0) {
+        error = std::string(name) + ": doorbell: " + strerror(errno);
+        if (doorbell >= 0) close(doorbell);
+        munmap(map, sizeof(RtInjectRing));
+        return nullptr;
+    }
+
+    // Clients attached to an earlier instance see the magic vanish; the
+    // ring is valid again once it is set
+    RtInjectRing *ring = static_cast<RtInjectRing *>(map);
+    ring->magic = 0;
+    new (ring) RtInjectRing;
+    ring->version = kRtInjectVersion;
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->tail.store(0, std::memory_order_relaxed);
+    ring->consumer_waiting.store(0, std::memory_order_relaxed);
+    ring->wire_id.store(0, std::memory_order_relaxed);
+    ring->wire_futex.store(0, std::memory_order_relaxed);
+    for (uint64_t i = 0; i < kRtInjectSlots; i++) {
+        ring->slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    ring->magic = kRtInjectMagic;
+    return std::unique_ptr<InjectSource>(new InjectSource(name, ring, doorbell));
+}
+
+InjectSource::~InjectSource() {
+    ring_->magic = 0;
+    munmap(ring_, sizeof(RtInjectRing));
+    shm_unlink(name_.c_str());
+    close(doorbell_);
+}
+
+void InjectSource::clear_doorbell() {
+    char buf[64];
+    while (recv(doorbell_, buf, sizeof(buf), 0) > 0) {
+    }
+}
+
+void InjectSource::publish(uint64_t id) {
+    if (id <= ring_->wire_id.load(std::memory_order_relaxed)) {
+        return;
+    }
+    ring_->wire_id.store(id, std::memory_order_release);
+    ring_->wire_futex.fetch_add(1, std::memory_order_release);
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&ring_->wire_futex), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
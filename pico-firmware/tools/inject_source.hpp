@@ -0,0 +1,81 @@
+#ifndef INJECT_SOURCE_HPP
+#define INJECT_SOURCE_HPP
+
+// Consumer side of the rt_inject shared memory ring (rt_inject.h): owns
+// the ring, hands due events to the daemon and publishes how far they
+// have been put on the wire for rt_inject_fence().
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "rt_inject_ring.hpp"
+
+class InjectSource {
+public:
+    static std::unique_ptr<InjectSource> create(const char *name, std::string &error);
+    ~InjectSource();
+
+    InjectSource(const InjectSource &) = delete;
+    InjectSource &operator=(const InjectSource &) = delete;
+
+    // Doorbell producers ring when the ring was empty
+    int fd() const { return doorbell_; }
+    void clear_doorbell();
+
+    // Pass due events to fn(event, id) in ring order, returns when the
+    // next one is due, or UINT64_MAX with the doorbell armed if the ring
+    // is empty.  fn returns false to leave the event in the ring until
+    // the next call.
+    template <typename Fn>
+    uint64_t release(uint64_t now_us, Fn &&fn);
+
+    // Events up to id are on the wire, wakes up fences
+    void publish(uint64_t id);
+
+    uint64_t consumed() const { return ring_->tail.load(std::memory_order_relaxed); }
+    uint64_t wire_id() const { return ring_->wire_id.load(std::memory_order_relaxed); }
+
+private:
+    InjectSource(std::string name, RtInjectRing *ring, int doorbell)
+        : name_(std::move(name)), ring_(ring), doorbell_(doorbell) {}
+
+    const RtInjectSlot *peek() const {
+        uint64_t pos = ring_->tail.load(std::memory_order_relaxed);
+        const RtInjectSlot &slot = ring_->slots[pos % kRtInjectSlots];
+        return slot.seq.load(std::memory_order_acquire) == pos + 1 ? &slot : nullptr;
+    }
+
+    std::string name_;
+    RtInjectRing *ring_;
+    int doorbell_;
+};
+
+template <typename Fn>
+uint64_t InjectSource::release(uint64_t now_us, Fn &&fn) {
+    while (true) {
+        const RtInjectSlot *slot = peek();
+        if (!slot) {
+            // Arm the doorbell, then look again so that an event published
+            // in between is not left waiting for the next one
+            ring_->consumer_waiting.store(1, std::memory_order_seq_cst);
+            slot = peek();
+            if (!slot) {
+                return UINT64_MAX;
+            }
+            ring_->consumer_waiting.store(0, std::memory_order_relaxed);
+        }
+        rt_inject_event event = slot->event;
+        if (event.at_us > now_us) {
+            return event.at_us;
+        }
+        uint64_t pos = ring_->tail.load(std::memory_order_relaxed);
+        if (!fn(event, pos + 1)) {
+            return UINT64_MAX;
+        }
+        const_cast<RtInjectSlot *>(slot)->seq.store(pos + kRtInjectSlots, std::memory_order_release);
+        ring_->tail.store(pos + 1, std::memory_order_relaxed);
+    }
+}
+
+#endif // INJECT_SOURCE_HPP
@@ -0,0 +1,91 @@
+#include "jitter_buffer.hpp"
+
+#include <algorithm>
+
+// The base transit time is the minimum over a window, so that it can
+// follow clock drift between sender and receiver, the spread is the
+// maximum above it
+static constexpr uint64_t kTransitWindowUs = 10000000;
+
+bool JitterBuffer::push(uint16_t seq, uint32_t sender_us, uint8_t buttons, int16_t dx, int16_t dy,
+                        uint64_t now_us) {
+    // Sequence bookkeeping: gaps count as lost until the missing events
+    // turn up late, a window of 64 catches duplicates.  Further back
+    // than that the client has restarted, with a new sequence and
+    // probably a new clock, and the buffer starts over.
+    int16_t ahead = (int16_t)(seq - next_seq_);
+    if (started_ && ahead < -64) {
+        stats_.restarts++;
+        started_ = false;
+        seen_ = 0;
+    }
+    if (!started_) {
+        ahead = 0;
+        next_seq_ = seq;
+    }
+    if (ahead >= 0) {
+        stats_.lost += ahead;
+        seen_ = ahead >= 63 ? 0 : seen_ << (ahead + 1);
+        seen_ |= 1;
+        next_seq_ = (uint16_t)(seq + 1);
+    } else {
+        int back = -ahead - 1;
+        if (back >= 64 || (seen_ & (1ull << back))) {
+            stats_.duplicates++;
+            return false;
+        }
+        seen_ |= 1ull << back;
+        if (stats_.lost) {
+            stats_.lost--;
+        }
+        stats_.reordered++;
+    }
+    stats_.received++;
+
+    // Extend the sender's 32-bit clock, reordered events may step back
+    if (!started_) {
+        sender_us_ = sender_us;
+    } else {
+        sender_us_ += (int32_t)(sender_us - last_sender_us_);
+    }
+    last_sender_us_ = sender_us;
+    int64_t transit_us = (int64_t)now_us - (int64_t)sender_us_;
+
+    if (!started_) {
+        base_transit_us_ = window_min_us_ = transit_us;
+        window_start_us_ = now_us;
+        last_transit_us_ = transit_us;
+        delay_us_ = config_.min_delay_us;
+        started_ = true;
+    }
+    if (now_us - window_start_us_ > kTransitWindowUs) {
+        base_transit_us_ = window_min_us_;
+        spread_us_ = window_spread_us_;
+        window_min_us_ = transit_us;
+        window_spread_us_ = 0;
+        window_start_us_ = now_us;
+    }
+    window_min_us_ = std::min(window_min_us_, transit_us);
+    base_transit_us_ = std::min(base_transit_us_, transit_us);
+    window_spread_us_ = std::max(window_spread_us_, transit_us - base_transit_us_);
+    spread_us_ = std::max(spread_us_, window_spread_us_);
+
+    int64_t d = transit_us - last_transit_us_;
+    last_transit_us_ = transit_us;
+    int64_t abs_d_q4 = (d < 0 ? -d : d) * 16;
+    jitter_q4_ += (abs_d_q4 - jitter_q4_) / 16;
+    uint64_t target_us = std::max<uint64_t>(config_.jitter_factor * (uint64_t)(jitter_q4_ >> 4),
+                                            (uint64_t)spread_us_);
+    delay_us_ = (uint32_t)std::clamp<uint64_t>(target_us, config_.min_delay_us, config_.max_delay_us);
+
+    uint64_t playout_us = (uint64_t)((int64_t)sender_us_ + base_transit_us_) + delay_us_;
+    if (playout_us < now_us) {
+        stats_.late++;
+        playout_us = now_us;
+    }
+    JitterEvent event = { playout_us, seq, buttons, false, dx, dy };
+    auto pos = std::upper_bound(queue_.begin(), queue_.end(), playout_us,
+                                [](uint64_t t, const Entry &e) { return t < e.event.playout_us; });
+    queue_.insert(pos, Entry{ event, now_us, (uint32_t)stats_.restarts });
+    return true;
+}
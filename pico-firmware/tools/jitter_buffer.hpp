@@ -0,0 +1,107 @@
+#ifndef JITTER_BUFFER_HPP
+#define JITTER_BUFFER_HPP
+
+// Adaptive jitter buffer for pointer events from one network client.
+//
+// Each event carries the sender's timestamp.  Its playout time is that
+// timestamp mapped to the local clock with the smallest transit time
+// seen recently, plus a delay within configured limits.  The delay
+// covers the spread of transit times seen recently, and at least a
+// multiple of the RFC 3550 jitter estimate.  Bursts are thereby spread
+// out again to the pace at which the motion happened.  Late events are
+// released at once rather than dropped, since every lost count moves the
+// pointer to a different place.
+
+#include <cstdint>
+#include <deque>
+
+#include "rt_session.hpp"
+
+struct JitterConfig {
+    uint32_t min_delay_us = 2000;
+    uint32_t max_delay_us = 100000;
+    uint32_t jitter_factor = 3;      // delay = factor * jitter
+};
+
+struct JitterStats {
+    uint64_t received = 0;
+    uint64_t lost = 0;               // sequence numbers never seen
+    uint64_t late = 0;               // arrived after their playout time
+    uint64_t duplicates = 0;
+    uint64_t reordered = 0;
+    uint64_t restarts = 0;           // sequence jumped back beyond the window
+    DelayStats queue_delay;          // arrival to release
+};
+
+struct JitterEvent {
+    uint64_t playout_us;
+    uint16_t seq;
+    uint8_t buttons;
+    bool stale;                      // older than an event already released
+    int16_t dx;
+    int16_t dy;
+};
+
+class JitterBuffer {
+public:
+    explicit JitterBuffer(const JitterConfig &config) : config_(config) {}
+
+    // Queue an event, returns false if it was a duplicate
+    bool push(uint16_t seq, uint32_t sender_us, uint8_t buttons, int16_t dx, int16_t dy, uint64_t now_us);
+
+    // Hand all events due at now_us to release(const JitterEvent &)
+    template <class Release>
+    void release(uint64_t now_us, Release &&release) {
+        while (!queue_.empty() && queue_.front().event.playout_us <= now_us) {
+            Entry entry = queue_.front();
+            queue_.pop_front();
+            stats_.queue_delay.add(now_us - entry.arrival_us);
+            if (released_any_ && (entry.epoch < released_epoch_ ||
+                                  (entry.epoch == released_epoch_ &&
+                                   (int16_t)(entry.event.seq - last_released_seq_) < 0))) {
+                entry.event.stale = true;
+            } else {
+                last_released_seq_ = entry.event.seq;
+                released_epoch_ = entry.epoch;
+                released_any_ = true;
+            }
+            release(entry.event);
+        }
+    }
+
+    // Playout time of the next event, 0 if the buffer is empty
+    uint64_t next_release_us() const { return queue_.empty() ? 0 : queue_.front().event.playout_us; }
+
+    uint32_t delay_us() const { return delay_us_; }
+    uint32_t jitter_us() const { return (uint32_t)(jitter_q4_ >> 4); }
+    const JitterStats &stats() const { return stats_; }
+
+private:
+    struct Entry {
+        JitterEvent event;
+        uint64_t arrival_us;
+        uint32_t epoch;              // restarts_ when it arrived
+    };
+
+    JitterConfig config_;
+    JitterStats stats_;
+    std::deque<Entry> queue_;
+    bool started_ = false;
+    uint64_t sender_us_ = 0;         // sender clock extended to 64 bits
+    uint32_t last_sender_us_ = 0;
+    int64_t last_transit_us_ = 0;
+    int64_t base_transit_us_ = 0;    // smallest transit in this or the last window
+    int64_t window_min_us_ = 0;
+    int64_t spread_us_ = 0;          // largest transit above base in this or the last window
+    int64_t window_spread_us_ = 0;
+    uint64_t window_start_us_ = 0;
+    int64_t jitter_q4_ = 0;          // RFC 3550 jitter, 1/16 us
+    uint32_t delay_us_ = 0;
+    uint16_t next_seq_ = 0;
+    uint64_t seen_ = 0;              // bit n: next_seq_ - 1 - n was received
+    uint16_t last_released_seq_ = 0;
+    uint32_t released_epoch_ = 0;
+    bool released_any_ = false;
+};
+
+#endif // JITTER_BUFFER_HPP
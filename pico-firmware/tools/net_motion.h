@@ -0,0 +1,32 @@
+#ifndef NET_MOTION_H
+#define NET_MOTION_H
+
+// Datagram format of rt-netmouse, one datagram per pointer event, sent
+// over UDP or a Unix datagram socket.  All fields are little-endian.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NET_MOTION_MAGIC 0x4d52   // "RM"
+#define NET_MOTION_VERSION 1
+#define NET_MOTION_PORT 6150
+
+struct NetMotion {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t buttons;    // 0x01 left, 0x02 right, 0x04 middle, as on USB
+    uint16_t client;    // chosen by the sender, tells clients apart
+    uint16_t seq;       // incremented with every datagram
+    uint32_t time_us;   // sender's clock when the motion happened
+    int16_t dx;
+    int16_t dy;         // positive is down, as on USB
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NET_MOTION_H
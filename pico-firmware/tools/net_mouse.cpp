@@ -0,0 +1,173 @@
+#include "net_mouse.hpp"
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+std::string peer_name(const struct sockaddr_storage &addr, socklen_t len) {
+    char buf[INET6_ADDRSTRLEN + 8] = "local";
+    if (addr.ss_family == AF_INET) {
+        const struct sockaddr_in *in = (const struct sockaddr_in *)&addr;
+        inet_ntop(AF_INET, &in->sin_addr, buf, sizeof(buf));
+        snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), ":%d", ntohs(in->sin_port));
+    } else if (addr.ss_family == AF_UNIX && len > offsetof(struct sockaddr_un, sun_path)) {
+        // Abstract names start with a NUL and are not NUL-terminated,
+        // their length is that of the address
+        const struct sockaddr_un *un = (const struct sockaddr_un *)&addr;
+        size_t path_len = len - offsetof(struct sockaddr_un, sun_path);
+        if (un->sun_path[0]) {
+            return std::string(un->sun_path, strnlen(un->sun_path, path_len));
+        }
+        return "@" + std::string(un->sun_path + 1, path_len - 1);
+    }
+    return buf;
+}
+
+Rt &NetMouse::add_rt(std::unique_ptr<RtLink> link, uint64_t tag) {
+    rts_.emplace_back(std::move(link));
+    Rt &rt = rts_.back();
+    rt.session.add_motion(0, 0, 0, tag);
+    rt.wire_tag = tag;
+    return rt;
+}
+
+void NetMouse::receive(int fd, uint64_t now_us) {
+    while (true) {
+        struct NetMotion m;
+        struct sockaddr_storage addr;
+        socklen_t addr_len = sizeof(addr);
+        ssize_t n = recvfrom(fd, &m, sizeof(m), 0, (struct sockaddr *)&addr, &addr_len);
+        if (n < 0) {
+            return;
+        }
+        if (n != sizeof(m) || le16toh(m.magic) != NET_MOTION_MAGIC || m.version != NET_MOTION_VERSION) {
+            malformed_++;
+            continue;
+        }
+        uint16_t id = le16toh(m.client);
+        push(peer_name(addr, addr_len) + "#" + std::to_string(id), m, now_us);
+    }
+}
+
+void NetMouse::push(const std::string &key, const NetMotion &m, uint64_t now_us) {
+    auto it = clients_.find(key);
+    if (it == clients_.end()) {
+        it = clients_.emplace(key, Client(key, jitter_)).first;
+        fprintf(stderr, "Client %s connected\n", key.c_str());
+    }
+    Client &client = it->second;
+    client.last_seen_us = now_us;
+    client.buffer.push(le16toh(m.seq), le32toh(m.time_us), m.buttons,
+                       (int16_t)le16toh(m.dx), (int16_t)le16toh(m.dy), now_us);
+}
+
+uint64_t NetMouse::release(uint64_t now_us) {
+    uint64_t next_us = UINT64_MAX;
+    bool buttons_changed = false;
+    for (auto it = clients_.begin(); it != clients_.end();) {
+        Client &client = it->second;
+        // Buttons first, like injected events: the motion of an event
+        // is sent with the buttons it carries
+        client.buffer.release(now_us, [&](const JitterEvent &event) {
+            if (!event.stale && event.buttons != client.buttons) {
+                client.buttons = event.buttons;
+                merge_buttons(now_us, 0);
+            }
+            add_motion(event.dx, event.dy, now_us, 0);
+        });
+        if (client.buffer.next_release_us()) {
+            next_us = std::min(next_us, client.buffer.next_release_us());
+        } else if (now_us - client.last_seen_us > kClientTimeoutUs) {
+            fprintf(stderr, "Client %s timed out\n", client.name.c_str());
+            print_client(client);
+            buttons_changed |= client.buttons != 0;
+            it = clients_.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    if (buttons_changed) {
+        merge_buttons(now_us, 0);
+    }
+    return next_us;
+}
+
+bool NetMouse::inject(const rt_inject_event &event, uint64_t id, uint64_t now_us) {
+    if (rts_.empty()) {
+        return false;
+    }
+    uint64_t barrier = event.flags & RT_INJECT_BUTTONS ? id - 1 : inject_buttons_id_;
+    for (const Rt &rt : rts_) {
+        if (rt.session.sent_tag() < barrier) {
+            return false;
+        }
+    }
+    if (event.flags & RT_INJECT_BUTTONS) {
+        inject_buttons_ = event.buttons;
+        inject_buttons_id_ = id;
+        merge_buttons(now_us, id);
+    }
+    add_motion(event.dx, event.dy, now_us, id);
+    return true;
+}
+
+uint64_t NetMouse::wire_tag(uint64_t tag) const {
+    for (const Rt &rt : rts_) {
+        tag = std::min(tag, rt.wire_tag);
+    }
+    return tag;
+}
+
+void NetMouse::print_stats() const {
+    for (const Rt &rt : rts_) {
+        print_rt(rt);
+    }
+    if (malformed_) {
+        fprintf(stderr, "Malformed datagrams: %llu\n", (unsigned long long)malformed_);
+    }
+    for (const auto &entry : clients_) {
+        print_client(entry.second);
+    }
+}
+
+void NetMouse::print_rt(const Rt &rt) {
+    const MouseState &state = rt.session.state();
+    const DelayStats &wire = rt.session.wire_delay();
+    fprintf(stderr, "RT %s: %s, %s, rate %d, %llu reports, release to report min %llu avg %llu max %llu us\n",
+            rt.link->name().c_str(), state.initialized ? "initialized" : "not initialized",
+            state.enabled ? "enabled" : "disabled", state.sample_rate, (unsigned long long)rt.session.reports(),
+            (unsigned long long)wire.min, (unsigned long long)wire.avg(), (unsigned long long)wire.max);
+}
+
+void NetMouse::add_motion(int32_t dx, int32_t dy, uint64_t now_us, uint64_t tag) {
+    for (Rt &rt : rts_) {
+        rt.session.add_motion(dx, dy, now_us, tag);
+    }
+}
+
+void NetMouse::merge_buttons(uint64_t now_us, uint64_t tag) {
+    uint8_t buttons = inject_buttons_;
+    for (const auto &entry : clients_) {
+        buttons |= entry.second.buttons;
+    }
+    for (Rt &rt : rts_) {
+        rt.session.set_buttons(buttons, now_us, tag);
+    }
+}
+
+void NetMouse::print_client(const Client &client) {
+    const JitterStats &s = client.buffer.stats();
+    fprintf(stderr, "Client %s: %llu received, %llu lost, %llu late, %llu duplicates, %llu reordered, "
+            "%llu restarts, queueing min %llu avg %llu max %llu us, jitter %u us, delay %u us\n",
+            client.name.c_str(), (unsigned long long)s.received, (unsigned long long)s.lost,
+            (unsigned long long)s.late, (unsigned long long)s.duplicates, (unsigned long long)s.reordered,
+            (unsigned long long)s.restarts,
+            (unsigned long long)s.queue_delay.min, (unsigned long long)s.queue_delay.avg(),
+            (unsigned long long)s.queue_delay.max, client.buffer.jitter_us(), client.buffer.delay_us());
+}
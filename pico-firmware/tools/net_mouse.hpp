@@ -0,0 +1,93 @@
+#ifndef NET_MOUSE_HPP
+#define NET_MOUSE_HPP
+
+// The pointer rt-netmouse follows: network clients, each with a jitter
+// buffer, and events injected through shared memory, merged into every
+// RT session.  Button changes are applied per event, so the sessions
+// send each of them in a report of its own.
+
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "jitter_buffer.hpp"
+#include "net_motion.h"
+#include "rt_inject.h"
+#include "rt_link.hpp"
+#include "rt_session.hpp"
+
+// A client that has not sent anything for this long is forgotten, and
+// its buttons are released
+constexpr uint64_t kClientTimeoutUs = 5000000;
+
+struct Client {
+    std::string name;
+    JitterBuffer buffer;
+    uint8_t buttons = 0;
+    uint64_t last_seen_us = 0;
+
+    Client(std::string n, const JitterConfig &config) : name(std::move(n)), buffer(config) {}
+};
+
+// One RT on a link
+struct Rt {
+    std::unique_ptr<RtLink> link;
+    RtSession session;
+    uint64_t wire_tag = 0;   // session.sent_tag() when the link was last idle
+
+    explicit Rt(std::unique_ptr<RtLink> l) : link(std::move(l)), session(*link) {}
+};
+
+// "host:port" or a Unix socket path, "@name" for abstract ones
+std::string peer_name(const struct sockaddr_storage &addr, socklen_t len);
+
+class NetMouse {
+public:
+    explicit NetMouse(const JitterConfig &jitter) : jitter_(jitter) {}
+
+    std::list<Rt> &rts() { return rts_; }
+
+    // A new RT starts with the buttons released; tag is the last event
+    // taken from the shared memory ring, which it has nothing to send of
+    Rt &add_rt(std::unique_ptr<RtLink> link, uint64_t tag);
+
+    // Read all pending datagrams from a socket
+    void receive(int fd, uint64_t now_us);
+    // Queue one datagram of the client named key
+    void push(const std::string &key, const NetMotion &m, uint64_t now_us);
+
+    // Move due events into the sessions, returns the next release time
+    uint64_t release(uint64_t now_us);
+
+    // Apply an event from the shared memory ring, false if it has to
+    // wait.  A button change gets a report of its own, after all earlier
+    // motion, so a click in one batch is neither merged away nor turned
+    // into a drag.  Without an RT events stay in the ring, taking them
+    // would count them as on the wire.
+    bool inject(const rt_inject_event &event, uint64_t id, uint64_t now_us);
+
+    // Last injected event on the wire on every link, at most tag.  There
+    // has to be a link.
+    uint64_t wire_tag(uint64_t tag) const;
+
+    void print_stats() const;
+    static void print_rt(const Rt &rt);
+
+private:
+    void add_motion(int32_t dx, int32_t dy, uint64_t now_us, uint64_t tag);
+    void merge_buttons(uint64_t now_us, uint64_t tag);
+    static void print_client(const Client &client);
+
+    JitterConfig jitter_;
+    std::list<Rt> rts_;
+    std::map<std::string, Client> clients_;
+    uint64_t malformed_ = 0;
+    uint8_t inject_buttons_ = 0;
+    uint64_t inject_buttons_id_ = 0;
+};
+
+#endif // NET_MOUSE_HPP
@@ -0,0 +1,147 @@
+// Render flight recorder dumps from a debug console capture as a
+// timeline.  Lines that are not part of a dump are ignored, so the
+// whole console log can be fed in.
+//
+//   rt-flight [-g gap_ms] [file...]
+//
+// Times are in milliseconds relative to the trigger event of each dump.
+// Quiet periods longer than gap_ms (default 50) are marked.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "flight_recorder.h"
+#include "fr_decode.hpp"
+
+namespace {
+
+struct Dump {
+    std::string header;
+    std::vector<Event> events;
+};
+
+class Renderer {
+public:
+    explicit Renderer(double gap_ms) : gap_ms_(gap_ms) {}
+
+    void render(const Dump &dump) {
+        printf("%s\n", dump.header.c_str());
+        if (dump.events.empty()) {
+            return;
+        }
+        uint32_t zero_us = dump.events.back().time_us;
+        for (const Event &event : dump.events) {
+            if (event.type == FR_EVENT_TRIGGER) {
+                zero_us = event.time_us;
+            }
+        }
+        decoder_.reset();
+        const Event *previous = nullptr;
+        for (const Event &event : dump.events) {
+            if (previous) {
+                double gap_ms = (uint32_t)(event.time_us - previous->time_us) / 1000.0;
+                if (gap_ms > gap_ms_) {
+                    printf("%12s  ---- %.1f ms quiet ----\n", "", gap_ms);
+                }
+            }
+            double time_ms = (int32_t)(event.time_us - zero_us) / 1000.0;
+            printf("%12.3f  %s\n", time_ms, decoder_.describe(event).c_str());
+            previous = &event;
+        }
+        printf("\n");
+    }
+
+private:
+    double gap_ms_;
+    EventDecoder decoder_;
+};
+
+// Parse "FR <time> <type> <data>", returns false for other lines
+bool parse_event(const std::string &line, Event &event) {
+    if (line.compare(0, 3, "FR ") != 0) {
+        return false;
+    }
+    std::istringstream in(line.substr(3));
+    std::string time, type, data;
+    if (!(in >> time >> type)) {
+        return false;
+    }
+    in >> data;
+    if (data.size() % 2 || data.size() > 2 * sizeof(FlightEvent::data)) {
+        return false;
+    }
+    event.time_us = (uint32_t)strtoul(time.c_str(), nullptr, 16);
+    event.type = (uint8_t)strtoul(type.c_str(), nullptr, 16);
+    event.data.clear();
+    for (size_t i = 0; i < data.size(); i += 2) {
+        event.data.push_back((uint8_t)strtoul(data.substr(i, 2).c_str(), nullptr, 16));
+    }
+    return true;
+}
+
+void read_dumps(std::istream &in, std::vector<Dump> &dumps) {
+    std::string line;
+    bool in_dump = false;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.compare(0, 24, "Flight recorder: trigger") == 0) {
+            dumps.push_back(Dump{line, {}});
+            in_dump = true;
+        } else if (line.compare(0, 28, "Flight recorder: end of dump") == 0) {
+            in_dump = false;
+        } else if (in_dump) {
+            Event event;
+            if (parse_event(line, event)) {
+                dumps.back().events.push_back(event);
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    double gap_ms = 50;
+    std::vector<const char *> files;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-g") && i + 1 < argc) {
+            gap_ms = atof(argv[++i]);
+        } else if (argv[i][0] == '-' && argv[i][1]) {
+            fprintf(stderr, "usage: %s [-g gap_ms] [file...]\n", argv[0]);
+            return 2;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    std::vector<Dump> dumps;
+    if (files.empty()) {
+        read_dumps(std::cin, dumps);
+    }
+    for (const char *file : files) {
+        std::ifstream in(file);
+        if (!in) {
+            fprintf(stderr, "%s: cannot open %s\n", argv[0], file);
+            return 1;
+        }
+        read_dumps(in, dumps);
+    }
+    if (dumps.empty()) {
+        fprintf(stderr, "%s: no flight recorder dump found\n", argv[0]);
+        return 1;
+    }
+
+    Renderer renderer(gap_ms);
+    for (const Dump &dump : dumps) {
+        renderer.render(dump);
+    }
+    return 0;
+}
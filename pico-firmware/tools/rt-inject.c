@@ -0,0 +1,95 @@
+// Inject pointer events into a running rt-netmouse -m <name>, for
+// scripted RT UI tests.
+//
+//   rt-inject [-m name] [-t timeout_ms] command...
+//
+//   move DX DY     relative motion, y positive is down
+//   buttons B      set the buttons (1 left, 2 right, 4 middle)
+//   click B        press and release buttons B
+//   after MS       deliver the following events MS after the start
+//
+// All events are queued as one batch, then rt-inject waits until the
+// last one has been put on the wire and prints how long that took.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rt_inject.h"
+
+#define MAX_EVENTS 1024
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-m name] [-t timeout_ms] {move DX DY | buttons B | click B | after MS}...\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    const char *name = RT_INJECT_DEFAULT_NAME;
+    int timeout_ms = 5000;
+    int c;
+    while ((c = getopt(argc, argv, "+m:t:")) != -1) {
+        switch (c) {
+            case 'm': name = optarg; break;
+            case 't': timeout_ms = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind == argc) {
+        usage(argv[0]);
+    }
+
+    static struct rt_inject_event events[MAX_EVENTS];
+    size_t count = 0;
+    uint64_t start_us = rt_inject_now_us();
+    uint64_t at_us = 0;
+    for (int i = optind; i < argc; i++) {
+        const char *cmd = argv[i];
+        if (count + 2 > MAX_EVENTS) {
+            fprintf(stderr, "Too many events\n");
+            return 2;
+        }
+        if (!strcmp(cmd, "move") && i + 2 < argc) {
+            struct rt_inject_event event = { at_us, (int16_t)atoi(argv[i + 1]), (int16_t)atoi(argv[i + 2]), 0, 0 };
+            events[count++] = event;
+            i += 2;
+        } else if ((!strcmp(cmd, "buttons") || !strcmp(cmd, "click")) && i + 1 < argc) {
+            struct rt_inject_event event = { at_us, 0, 0, (uint8_t)strtoul(argv[i + 1], NULL, 0), RT_INJECT_BUTTONS };
+            events[count++] = event;
+            if (!strcmp(cmd, "click")) {
+                event.buttons = 0;
+                events[count++] = event;
+            }
+            i += 1;
+        } else if (!strcmp(cmd, "after") && i + 1 < argc) {
+            at_us = start_us + (uint64_t)(atof(argv[i + 1]) * 1000);
+            i += 1;
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    rt_inject *inject = rt_inject_open(name);
+    if (!inject) {
+        perror(name);
+        return 1;
+    }
+    uint64_t id = count ? rt_inject_submit(inject, events, count) : 0;
+    if (count && !id) {
+        fprintf(stderr, "%s: ring full\n", name);
+        rt_inject_close(inject);
+        return 1;
+    }
+    int result = 0;
+    if (id) {
+        if (rt_inject_fence(inject, id, timeout_ms) < 0) {
+            fprintf(stderr, "Event %llu not on the wire after %d ms\n", (unsigned long long)id, timeout_ms);
+            result = 1;
+        } else {
+            printf("%zu events on the wire after %.1f ms\n", count, (rt_inject_now_us() - start_us) / 1000.0);
+        }
+    }
+    rt_inject_close(inject);
+    return result;
+}
@@ -0,0 +1,154 @@
+// Stand-in client for rt-netmouse, sends synthetic pointer motion.
+//
+//   rt-netmouse-client [-h host] [-u port] [-U path] [-c client] [-r rate]
+//                      [-n count] [-b burst] [-l loss_pct] [-a amplitude]
+//
+// Events are sent at rate per second, in bursts of burst datagrams to
+// imitate a congested network, and loss_pct percent of them are dropped
+// on purpose.  The motion is a circle of the given amplitude per event,
+// so the pointer ends where it started if nothing was lost.
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "net_motion.h"
+
+namespace {
+
+uint64_t monotonic_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+void sleep_until(uint64_t t_us) {
+    uint64_t now = monotonic_us();
+    if (t_us > now) {
+        usleep((useconds_t)(t_us - now));
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *host = "127.0.0.1";
+    int port = NET_MOTION_PORT;
+    const char *unix_path = nullptr;
+    int client = getpid() & 0xffff;
+    int rate = 1000;
+    long count = 5000;
+    int burst = 1;
+    int loss_pct = 0;
+    int amplitude = 4;
+    int c;
+    while ((c = getopt(argc, argv, "h:u:U:c:r:n:b:l:a:")) != -1) {
+        switch (c) {
+            case 'h': host = optarg; break;
+            case 'u': port = atoi(optarg); break;
+            case 'U': unix_path = optarg; break;
+            case 'c': client = atoi(optarg); break;
+            case 'r': rate = atoi(optarg); break;
+            case 'n': count = atol(optarg); break;
+            case 'b': burst = atoi(optarg); break;
+            case 'l': loss_pct = atoi(optarg); break;
+            case 'a': amplitude = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-h host] [-u port] [-U path] [-c client] [-r rate] "
+                        "[-n count] [-b burst] [-l loss_pct] [-a amplitude]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (rate <= 0 || burst <= 0) {
+        fprintf(stderr, "%s: rate and burst must be positive\n", argv[0]);
+        return 2;
+    }
+
+    int fd;
+    struct sockaddr_storage addr = {};
+    socklen_t addr_len;
+    if (unix_path) {
+        fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+        struct sockaddr_un *un = (struct sockaddr_un *)&addr;
+        un->sun_family = AF_UNIX;
+        snprintf(un->sun_path, sizeof(un->sun_path), "%s", unix_path);
+        addr_len = sizeof(*un);
+        // Bind to an abstract address so that the daemon can tell
+        // clients apart
+        struct sockaddr_un self = {};
+        self.sun_family = AF_UNIX;
+        snprintf(self.sun_path + 1, sizeof(self.sun_path) - 1, "rt-netmouse-client-%d", (int)getpid());
+        bind(fd, (struct sockaddr *)&self, sizeof(self));
+    } else {
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        struct sockaddr_in *in = (struct sockaddr_in *)&addr;
+        in->sin_family = AF_INET;
+        in->sin_port = htons((uint16_t)port);
+        if (inet_pton(AF_INET, host, &in->sin_addr) != 1) {
+            fprintf(stderr, "%s: bad address %s\n", argv[0], host);
+            return 2;
+        }
+        addr_len = sizeof(*in);
+    }
+    if (fd < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    uint64_t period_us = 1000000 / (uint64_t)rate;
+    uint64_t start = monotonic_us();
+    std::vector<struct NetMotion> pending;
+    long sent = 0, dropped = 0;
+    double x = 0, y = 0;
+    int sx = 0, sy = 0;
+    srand(1);
+    for (long i = 0; i < count; i++) {
+        uint64_t t = start + (uint64_t)i * period_us;
+        sleep_until(t);
+        // Sample the circle and send the difference to the last sample
+        double angle = 2 * M_PI * (double)i / 256;
+        x = amplitude * 256 / (2 * M_PI) * sin(angle);
+        y = amplitude * 256 / (2 * M_PI) * (1 - cos(angle));
+        int nx = (int)lround(x);
+        int ny = (int)lround(y);
+        struct NetMotion m = {};
+        m.magic = htole16(NET_MOTION_MAGIC);
+        m.version = NET_MOTION_VERSION;
+        m.buttons = (i / 1000) % 2 ? 0x01 : 0x00;
+        m.client = htole16((uint16_t)client);
+        m.seq = htole16((uint16_t)i);
+        m.time_us = htole32((uint32_t)monotonic_us());
+        m.dx = (int16_t)htole16((uint16_t)(int16_t)(nx - sx));
+        m.dy = (int16_t)htole16((uint16_t)(int16_t)(ny - sy));
+        sx = nx;
+        sy = ny;
+        if (rand() % 100 < loss_pct) {
+            dropped++;
+        } else {
+            pending.push_back(m);
+        }
+        if ((long)pending.size() >= burst || i == count - 1) {
+            for (const struct NetMotion &p : pending) {
+                if (sendto(fd, &p, sizeof(p), 0, (struct sockaddr *)&addr, addr_len) < 0) {
+                    perror("sendto");
+                    return 1;
+                }
+                sent++;
+            }
+            pending.clear();
+        }
+    }
+    printf("%ld events sent, %ld dropped on purpose\n", sent, dropped);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,311 @@
+// Drive RT mouse ports from pointer events received over the network.
+//
+//   rt-netmouse [options] link...
+//
+//   link         serial port, or tcp:host:port / unix:path of an RT
+//                emulator's serial line to connect to
+//   -l listen    tcp:[host]:port or unix:path to accept emulator
+//                connections on, may be given more than once
+//   -b baud      model this line speed on socket links (default 0 =
+//                send at once, 9600 = like the real mouse line)
+//   -u port      UDP port to listen on (default 6150, 0 = none)
+//   -U path      Unix datagram socket to listen on
+//   -d min_ms    minimum jitter buffer delay (default 2)
+//   -D max_ms    maximum jitter buffer delay (default 100)
+//   -m name      shared memory ring for local injection (rt_inject.h),
+//                e.g. /rt-mouse
+//   -s seconds   print statistics this often (default only on SIGUSR1
+//                and at exit)
+//
+// Clients send one NetMotion datagram (net_motion.h) per pointer event.
+// Every client gets its own jitter buffer.  Motion released from them
+// is summed, buttons are ORed, and the result is paced into RT data
+// reports like the firmware does.  The RT's commands are answered by the
+// same protocol engine as in the firmware.  Every link is an RT of its
+// own with its own engine and pacer; all of them follow the same pointer.
+//
+// Events from the shared memory ring bypass the jitter buffers: they
+// are applied when due and counted as on the wire, for rt_inject_fence(),
+// once the reports carrying them have left every link.  While there is
+// no link they wait in the ring.
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "inject_source.hpp"
+#include "net_mouse.hpp"
+
+namespace {
+
+volatile sig_atomic_t stop_requested;
+volatile sig_atomic_t stats_requested;
+
+struct Options {
+    int udp_port = NET_MOTION_PORT;
+    const char *unix_path = nullptr;
+    const char *inject_name = nullptr;
+    std::vector<const char *> listen;
+    uint32_t baud = 0;
+    JitterConfig jitter;
+    double stats_s = 0;
+    std::vector<const char *> links;
+};
+
+void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-l listen]... [-b baud] [-u port] [-U path] [-m name] [-d min_ms] [-D max_ms] "
+            "[-s seconds] [link]...\n", argv0);
+    exit(2);
+}
+
+Options parse_options(int argc, char **argv) {
+    Options options;
+    int c;
+    while ((c = getopt(argc, argv, "l:b:u:U:m:d:D:s:")) != -1) {
+        switch (c) {
+            case 'l': options.listen.push_back(optarg); break;
+            case 'b': options.baud = (uint32_t)atoi(optarg); break;
+            case 'u': options.udp_port = atoi(optarg); break;
+            case 'U': options.unix_path = optarg; break;
+            case 'm': options.inject_name = optarg; break;
+            case 'd': options.jitter.min_delay_us = (uint32_t)(atof(optarg) * 1000); break;
+            case 'D': options.jitter.max_delay_us = (uint32_t)(atof(optarg) * 1000); break;
+            case 's': options.stats_s = atof(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    options.links.assign(argv + optind, argv + argc);
+    if ((options.links.empty() && options.listen.empty()) ||
+        options.jitter.min_delay_us > options.jitter.max_delay_us) {
+        usage(argv[0]);
+    }
+    return options;
+}
+
+int open_udp(int port) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("UDP socket");
+        exit(1);
+    }
+    return fd;
+}
+
+int open_unix_dgram(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: path too long\n", path);
+        exit(1);
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror(path);
+        exit(1);
+    }
+    return fd;
+}
+
+void print_inject_stats(const InjectSource *inject) {
+    if (inject) {
+        fprintf(stderr, "Injected: %llu events, %llu on the wire\n", (unsigned long long)inject->consumed(),
+                (unsigned long long)inject->wire_id());
+    }
+}
+
+void on_signal(int sig) {
+    if (sig == SIGUSR1) {
+        stats_requested = 1;
+    } else {
+        stop_requested = 1;
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options = parse_options(argc, argv);
+
+    std::string error;
+    NetMouse mouse(options.jitter);
+    for (const char *spec : options.links) {
+        std::unique_ptr<RtLink> link = RtLink::open(spec, error);
+        if (!link) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        if (!link->is_tty()) {
+            link->set_baud(options.baud);
+        }
+        mouse.add_rt(std::move(link), 0);
+    }
+    std::vector<std::unique_ptr<RtListener>> listeners;
+    for (const char *spec : options.listen) {
+        listeners.push_back(RtListener::open(spec, error));
+        if (!listeners.back()) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<int> net_fds;
+    if (options.udp_port) {
+        net_fds.push_back(open_udp(options.udp_port));
+    }
+    if (options.unix_path) {
+        net_fds.push_back(open_unix_dgram(options.unix_path));
+    }
+    std::unique_ptr<InjectSource> inject;
+    if (options.inject_name) {
+        inject = InjectSource::create(options.inject_name, error);
+        if (!inject) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    uint64_t inject_id = 0;   // last event taken from the ring
+
+    struct sigaction sa = {};
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    sigaction(SIGUSR1, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    uint64_t stats_interval_us = (uint64_t)(options.stats_s * 1000000);
+    uint64_t next_stats_us = stats_interval_us ? monotonic_us() + stats_interval_us : UINT64_MAX;
+    std::vector<struct pollfd> fds;
+    std::vector<Rt *> fd_rts;
+    while (!stop_requested) {
+        uint64_t now = monotonic_us();
+        uint64_t next_us = mouse.release(now);
+        if (inject) {
+            next_us = std::min(next_us, inject->release(now, [&](const rt_inject_event &event, uint64_t id) {
+                if (!mouse.inject(event, id, now)) {
+                    return false;
+                }
+                inject_id = id;
+                return true;
+            }));
+        }
+        for (auto it = mouse.rts().begin(); it != mouse.rts().end();) {
+            Rt &rt = *it;
+            next_us = std::min(next_us, rt.session.service(now));
+            if (!rt.link->flush()) {
+                fprintf(stderr, "%s: %s\n", rt.link->name().c_str(), strerror(errno));
+                it = mouse.rts().erase(it);
+                continue;
+            }
+            next_us = std::min(next_us, rt.link->next_flush_us());
+            if (rt.link->idle()) {
+                rt.wire_tag = rt.session.sent_tag();
+            }
+            ++it;
+        }
+        if (inject && !mouse.rts().empty()) {
+            inject->publish(mouse.wire_tag(inject_id));
+        }
+        if (mouse.rts().empty() && listeners.empty()) {
+            fprintf(stderr, "No RT left\n");
+            return 1;
+        }
+        if (now >= next_stats_us || stats_requested) {
+            stats_requested = 0;
+            mouse.print_stats();
+            print_inject_stats(inject.get());
+            if (now >= next_stats_us) {
+                next_stats_us = now + stats_interval_us;
+            }
+        }
+        next_us = std::min(next_us, next_stats_us);
+
+        // Listeners, network sockets, the doorbell, then one entry per RT
+        fds.clear();
+        fd_rts.clear();
+        for (const auto &listener : listeners) {
+            fds.push_back({ listener->fd(), POLLIN, 0 });
+        }
+        for (int fd : net_fds) {
+            fds.push_back({ fd, POLLIN, 0 });
+        }
+        if (inject) {
+            fds.push_back({ inject->fd(), POLLIN, 0 });
+        }
+        size_t rt_fds = fds.size();
+        for (Rt &rt : mouse.rts()) {
+            fds.push_back({ rt.link->fd(), (short)(POLLIN | (rt.link->want_write() ? POLLOUT : 0)), 0 });
+            fd_rts.push_back(&rt);
+        }
+
+        uint64_t wait_us = next_us > now ? next_us - now : 0;
+        struct timespec timeout = { (time_t)(wait_us / 1000000), (long)(wait_us % 1000000) * 1000 };
+        if (ppoll(fds.data(), fds.size(), &timeout, nullptr) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("ppoll");
+            return 1;
+        }
+        now = monotonic_us();
+        size_t i = 0;
+        for (const auto &listener : listeners) {
+            if (fds[i++].revents & POLLIN) {
+                while (std::unique_ptr<RtLink> link = listener->accept()) {
+                    link->set_baud(options.baud);
+                    fprintf(stderr, "RT %s connected\n", link->name().c_str());
+                    mouse.add_rt(std::move(link), inject_id);
+                }
+            }
+        }
+        for (int fd : net_fds) {
+            if (fds[i++].revents & POLLIN) {
+                mouse.receive(fd, now);
+            }
+        }
+        if (inject && (fds[i++].revents & POLLIN)) {
+            inject->clear_doorbell();
+        }
+        for (size_t j = 0; j < fd_rts.size(); j++) {
+            Rt *rt = fd_rts[j];
+            if (!(fds[rt_fds + j].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            uint8_t buf[64];
+            long n;
+            while ((n = rt->link->read(buf, sizeof(buf))) > 0) {
+                rt->session.receive(buf, (size_t)n);
+            }
+            if (n == 0 || n == -2) {
+                fprintf(stderr, "RT %s: line closed\n", rt->link->name().c_str());
+                NetMouse::print_rt(*rt);
+                mouse.rts().remove_if([rt](const Rt &r) { return &r == rt; });
+            }
+        }
+    }
+    mouse.print_stats();
+    print_inject_stats(inject.get());
+    if (options.unix_path) {
+        unlink(options.unix_path);
+    }
+    return 0;
+}
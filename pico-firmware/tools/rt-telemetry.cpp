@@ -0,0 +1,219 @@
+// Decode the firmware's telemetry stream (telemetry.h) live.
+//
+//   rt-telemetry [-b baud] [-g gap_ms] [-w file] tty|-
+//
+//   -b baud      line speed of the serial port (default 2000000)
+//   -g gap_ms    mark quiet periods longer than this (default 50)
+//   -w file      also write the raw stream to a file, which can be
+//                decoded again later with rt-telemetry - < file
+//
+// The serial port is the one connected to the TX pin of the adapter on
+// the converter's USB hub.  Times are in milliseconds since the first
+// record.  Records lost on the serial line are marked, events the
+// firmware had no room for show up as DROPPED.
+
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "fr_decode.hpp"
+#include "telemetry.h"
+
+namespace {
+
+volatile sig_atomic_t stop_requested;
+
+void on_signal(int) {
+    stop_requested = 1;
+}
+
+speed_t baud_constant(long baud) {
+    switch (baud) {
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        case 1000000: return B1000000;
+        case 1500000: return B1500000;
+        case 2000000: return B2000000;
+        case 3000000: return B3000000;
+        default: return 0;
+    }
+}
+
+// Raw 8N1, the adapter's default framing
+int open_serial(const char *path, speed_t speed) {
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+    struct termios tio;
+    if (fd < 0 || tcgetattr(fd, &tio) < 0) {
+        perror(path);
+        exit(1);
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~(CSIZE | CSTOPB | PARENB | CRTSCTS);
+    tio.c_cflag |= CS8 | CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(fd, TCSANOW, &tio) < 0) {
+        perror(path);
+        exit(1);
+    }
+    tcflush(fd, TCIFLUSH);
+    return fd;
+}
+
+class Receiver {
+public:
+    explicit Receiver(double gap_ms) : gap_ms_(gap_ms) {}
+
+    // Feed received bytes, frames end at 0x00
+    void feed(const uint8_t *data, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            if (data[i]) {
+                if (frame_len_ < sizeof(frame_)) {
+                    frame_[frame_len_] = data[i];
+                }
+                frame_len_++;
+                continue;
+            }
+            if (frame_len_) {
+                frame(frame_len_ <= sizeof(frame_) ? frame_len_ : 0);
+            }
+            frame_len_ = 0;
+        }
+    }
+
+    void print_summary() const {
+        fprintf(stderr, "%llu records, %llu lost, %llu bad frames, %llu events dropped by the firmware\n",
+                (unsigned long long)records_, (unsigned long long)lost_, (unsigned long long)bad_frames_,
+                (unsigned long long)dropped_);
+    }
+
+private:
+    void frame(size_t len) {
+        uint8_t record[TM_RECORD_MAX];
+        size_t record_len = len ? tm_cobs_decode(frame_, len, record, sizeof(record)) : 0;
+        if (record_len < 6) {
+            // Also the partial frame at the start of a capture
+            bad_frames_++;
+            printf("%12s  ---- bad frame ----\n", "");
+            decoder_.reset();
+            return;
+        }
+        Event event;
+        uint8_t seq = record[0];
+        event.time_us = record[1] | record[2] << 8 | record[3] << 16 | (uint32_t)record[4] << 24;
+        event.type = record[5];
+        event.data.assign(record + 6, record + record_len);
+
+        if (records_) {
+            uint8_t missing = (uint8_t)(seq - (uint8_t)(seq_ + 1));
+            if (missing) {
+                lost_ += missing;
+                printf("%12s  ---- %u records lost ----\n", "", missing);
+                decoder_.reset();
+            }
+            // The firmware's clock wraps every 71 minutes
+            time_us_ += (uint32_t)(event.time_us - last_time_us_);
+            double gap_ms = (uint32_t)(event.time_us - last_time_us_) / 1000.0;
+            if (gap_ms > gap_ms_) {
+                printf("%12s  ---- %.1f ms quiet ----\n", "", gap_ms);
+            }
+        }
+        if (event.type == FR_EVENT_DROPPED && event.data.size() >= 2) {
+            dropped_ += event.data[0] | event.data[1] << 8;
+            decoder_.reset();
+        }
+        seq_ = seq;
+        last_time_us_ = event.time_us;
+        records_++;
+        printf("%12.3f  %s\n", time_us_ / 1000.0, decoder_.describe(event).c_str());
+    }
+
+    double gap_ms_;
+    EventDecoder decoder_;
+    uint8_t frame_[TM_FRAME_MAX];
+    size_t frame_len_ = 0;
+    uint8_t seq_ = 0;
+    uint32_t last_time_us_ = 0;
+    uint64_t time_us_ = 0;
+    uint64_t records_ = 0;
+    uint64_t lost_ = 0;
+    uint64_t bad_frames_ = 0;
+    uint64_t dropped_ = 0;
+};
+
+void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-b baud] [-g gap_ms] [-w file] tty|-\n", argv0);
+    exit(2);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    long baud = 2000000;
+    double gap_ms = 50;
+    const char *raw_path = nullptr;
+    int c;
+    while ((c = getopt(argc, argv, "b:g:w:")) != -1) {
+        switch (c) {
+            case 'b': baud = atol(optarg); break;
+            case 'g': gap_ms = atof(optarg); break;
+            case 'w': raw_path = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+    }
+    const char *path = argv[optind];
+    speed_t speed = baud_constant(baud);
+    if (!speed) {
+        fprintf(stderr, "%s: unsupported line speed %ld\n", argv[0], baud);
+        return 2;
+    }
+    int fd = strcmp(path, "-") ? open_serial(path, speed) : STDIN_FILENO;
+    FILE *raw = nullptr;
+    if (raw_path && !(raw = fopen(raw_path, "wb"))) {
+        perror(raw_path);
+        return 1;
+    }
+
+    struct sigaction sa = {};
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    Receiver receiver(gap_ms);
+    uint8_t buf[4096];
+    while (!stop_requested) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (n < 0) {
+                perror(path);
+            }
+            break;
+        }
+        if (raw) {
+            fwrite(buf, 1, (size_t)n, raw);
+        }
+        receiver.feed(buf, (size_t)n);
+    }
+    if (raw) {
+        fclose(raw);
+    }
+    receiver.print_summary();
+    return 0;
+}
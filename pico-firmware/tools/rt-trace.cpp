@@ -0,0 +1,172 @@
+// Read a trace file written by the firmware to a USB stick (trace_file.h).
+//
+//   rt-trace [-e] [-g gap_ms] [-f from_s] [-t to_s] RTnnnnnn.TRC
+//
+//   -e           print every event, not only the summary
+//   -g gap_ms    mark quiet periods longer than this (default 50)
+//   -f, -t       only print events in this window, in seconds since the
+//                first record
+//
+// The file is memory-mapped and its blocks are put back in the order they
+// were written, so a file that wrapped around starts with its oldest
+// block.  Times are in milliseconds since the first record.  Events the
+// firmware had no room for are marked where they were lost.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "fr_decode.hpp"
+#include "trace_file.h"
+
+namespace {
+
+struct Block {
+    uint32_t seq;
+    const TraceBlockHeader *header;
+    const FlightEvent *records;
+};
+
+void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-e] [-g gap_ms] [-f from_s] [-t to_s] file\n", argv0);
+    exit(2);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    bool events = false;
+    double gap_ms = 50;
+    double from_s = 0;
+    double to_s = -1;
+    int c;
+    while ((c = getopt(argc, argv, "eg:f:t:")) != -1) {
+        switch (c) {
+            case 'e': events = true; break;
+            case 'g': gap_ms = atof(optarg); break;
+            case 'f': from_s = atof(optarg); events = true; break;
+            case 't': to_s = atof(optarg); events = true; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+    }
+    const char *path = argv[optind];
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        return 1;
+    }
+    if ((size_t)st.st_size < TRACE_BLOCK_SIZE) {
+        fprintf(stderr, "%s: too short for a trace file\n", path);
+        return 1;
+    }
+    auto *file = (const uint8_t *)mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (file == MAP_FAILED) {
+        perror(path);
+        return 1;
+    }
+    close(fd);
+
+    const auto *header = (const TraceFileHeader *)file;
+    if (memcmp(header->magic, TRACE_FILE_MAGIC, sizeof(header->magic)) ||
+        header->version != TRACE_FILE_VERSION) {
+        fprintf(stderr, "%s: not a version %d trace file\n", path, TRACE_FILE_VERSION);
+        return 1;
+    }
+    if (header->block_size != TRACE_BLOCK_SIZE || header->block_header_size != sizeof(TraceBlockHeader) ||
+        header->record_size != sizeof(FlightEvent)) {
+        fprintf(stderr, "%s: unsupported block layout\n", path);
+        return 1;
+    }
+    uint64_t blocks = std::min<uint64_t>(header->blocks, (uint64_t)st.st_size / TRACE_BLOCK_SIZE - 1);
+
+    // Blocks of this session, in the order they were written.  Anything
+    // else is left over from what the stick held before.
+    std::vector<Block> order;
+    for (uint64_t i = 0; i < blocks; i++) {
+        const uint8_t *base = file + (i + 1) * TRACE_BLOCK_SIZE;
+        const auto *block = (const TraceBlockHeader *)base;
+        if (block->magic != TRACE_BLOCK_MAGIC || block->session != header->session ||
+            block->count > TRACE_BLOCK_RECORDS || block->seq % header->blocks != i) {
+            continue;
+        }
+        order.push_back({block->seq, block, (const FlightEvent *)(base + sizeof(TraceBlockHeader))});
+    }
+    std::sort(order.begin(), order.end(), [](const Block &a, const Block &b) { return a.seq < b.seq; });
+
+    EventDecoder decoder;
+    uint64_t records = 0;
+    uint64_t dropped = 0;
+    uint64_t missing = 0;
+    uint64_t first_us = 0;
+    uint64_t last_us = 0;
+    // Markers are printed with the first record after them
+    auto shown = [&](uint64_t time_us) {
+        double t_s = records ? (time_us - first_us) / 1e6 : 0;
+        return events && t_s >= from_s && (to_s < 0 || t_s <= to_s);
+    };
+    for (size_t i = 0; i < order.size(); i++) {
+        const Block &block = order[i];
+        if (i && block.seq != order[i - 1].seq + 1) {
+            // Not written: a write error, or the stick was unplugged
+            missing += block.seq - order[i - 1].seq - 1;
+            if (shown(block.header->start_us)) {
+                printf("%12s  ---- %u blocks missing ----\n", "", block.seq - order[i - 1].seq - 1);
+            }
+            decoder.reset();
+        }
+        if (block.header->dropped) {
+            dropped += block.header->dropped;
+            if (shown(block.header->start_us)) {
+                printf("%12s  ---- %u events dropped ----\n", "", block.header->dropped);
+            }
+            decoder.reset();
+        }
+        // The records carry the low 32 bits of the block's 64-bit clock
+        uint64_t time_us = block.header->start_us;
+        uint32_t prev_us = (uint32_t)time_us;
+        for (unsigned r = 0; r < block.header->count; r++) {
+            const FlightEvent &record = block.records[r];
+            time_us += (uint32_t)(record.time_us - prev_us);
+            prev_us = record.time_us;
+            if (!records) {
+                first_us = time_us;
+            }
+            bool show = shown(time_us);
+            if (show && records && time_us - last_us > gap_ms * 1000) {
+                printf("%12s  ---- %.1f ms quiet ----\n", "", (time_us - last_us) / 1000.0);
+            }
+            last_us = time_us;
+            records++;
+            if (!show) {
+                continue;
+            }
+            Event event;
+            event.time_us = record.time_us;
+            event.type = record.type;
+            event.data.assign(record.data, record.data + std::min<size_t>(record.len, sizeof(record.data)));
+            printf("%12.3f  %s\n", (time_us - first_us) / 1000.0, decoder.describe(event).c_str());
+        }
+    }
+
+    fprintf(stderr, "%s: session %08x, %zu of %llu blocks used", path, header->session, order.size(),
+            (unsigned long long)header->blocks);
+    if (!order.empty()) {
+        fprintf(stderr, " (seq %u to %u)", order.front().seq, order.back().seq);
+    }
+    fprintf(stderr, "\n%s: %llu records over %.3f s, %llu blocks missing, %llu events dropped by the firmware\n",
+            path, (unsigned long long)records, (last_us - first_us) / 1e6, (unsigned long long)missing,
+            (unsigned long long)dropped);
+    munmap((void *)file, (size_t)st.st_size);
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include "rt_inject.h"
+#include "rt_inject_ring.hpp"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <new>
+
+struct rt_inject {
+    RtInjectRing *ring;
+    int doorbell;
+    struct sockaddr_un doorbell_addr;
+    socklen_t doorbell_len;
+};
+
+rt_inject *rt_inject_open(const char *name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return nullptr;
+    }
+    void *map = mmap(nullptr, sizeof(RtInjectRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return nullptr;
+    }
+    RtInjectRing *ring = static_cast<RtInjectRing *>(map);
+    if (ring->magic != kRtInjectMagic || ring->version != kRtInjectVersion) {
+        munmap(map, sizeof(RtInjectRing));
+        errno = EPROTO;
+        return nullptr;
+    }
+    rt_inject *inject = new (std::nothrow) rt_inject();
+    if (!inject) {
+        munmap(map, sizeof(RtInjectRing));
+        errno = ENOMEM;
+        return nullptr;
+    }
+    inject->ring = ring;
+    inject->doorbell = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    inject->doorbell_addr.sun_family = AF_UNIX;
+    int len = rt_inject_doorbell_address(name, inject->doorbell_addr.sun_path,
+                                         (int)sizeof(inject->doorbell_addr.sun_path));
+    inject->doorbell_len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + len);
+    return inject;
+}
+
+void rt_inject_close(rt_inject *inject) {
+    if (inject) {
+        munmap(inject->ring, sizeof(RtInjectRing));
+        close(inject->doorbell);
+        delete inject;
+    }
+}
+
+uint64_t rt_inject_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+uint64_t rt_inject_submit(rt_inject *inject, const struct rt_inject_event *events, size_t count) {
+    RtInjectRing *ring = inject->ring;
+    if (!count || count > kRtInjectSlots) {
+        return 0;
+    }
+    // Reserve count positions.  Slots are freed in order, so if the last
+    // one is free all of them are.
+    uint64_t pos = ring->head.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t last = pos + count - 1;
+        uint64_t seq = ring->slots[last % kRtInjectSlots].seq.load(std::memory_order_acquire);
+        if (seq < last) {
+            return 0;
+        }
+        if (seq == last) {
+            if (ring->head.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                break;
+            }
+        } else {
+            pos = ring->head.load(std::memory_order_relaxed);
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        RtInjectSlot &slot = ring->slots[(pos + i) % kRtInjectSlots];
+        slot.event = events[i];
+        slot.seq.store(pos + i + 1, std::memory_order_release);
+    }
+    if (ring->consumer_waiting.exchange(0, std::memory_order_acq_rel)) {
+        char bell = 0;
+        sendto(inject->doorbell, &bell, 1, 0, (struct sockaddr *)&inject->doorbell_addr, inject->doorbell_len);
+    }
+    return pos + count;
+}
+
+uint64_t rt_inject_move(rt_inject *inject, int16_t dx, int16_t dy) {
+    struct rt_inject_event event = { 0, dx, dy, 0, 0 };
+    return rt_inject_submit(inject, &event, 1);
+}
+
+uint64_t rt_inject_buttons(rt_inject *inject, uint8_t buttons) {
+    struct rt_inject_event event = { 0, 0, 0, buttons, RT_INJECT_BUTTONS };
+    return rt_inject_submit(inject, &event, 1);
+}
+
+int rt_inject_fence(rt_inject *inject, uint64_t id, int timeout_ms) {
+    RtInjectRing *ring = inject->ring;
+    uint64_t deadline_us = timeout_ms < 0 ? 0 : rt_inject_now_us() + (uint64_t)timeout_ms * 1000;
+    while (true) {
+        uint32_t futex = ring->wire_futex.load(std::memory_order_acquire);
+        if (ring->wire_id.load(std::memory_order_acquire) >= id) {
+            return 0;
+        }
+        struct timespec timeout;
+        struct timespec *ptimeout = nullptr;
+        if (deadline_us) {
+            uint64_t now_us = rt_inject_now_us();
+            if (now_us >= deadline_us) {
+                return -1;
+            }
+            uint64_t wait_us = deadline_us - now_us;
+            timeout = { (time_t)(wait_us / 1000000), (long)(wait_us % 1000000) * 1000 };
+            ptimeout = &timeout;
+        }
+        // Shared futex: the word lives in memory mapped by both processes
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&ring->wire_futex), FUTEX_WAIT, futex, ptimeout,
+                nullptr, 0);
+    }
+}
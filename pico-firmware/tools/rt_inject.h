@@ -0,0 +1,60 @@
+#ifndef RT_INJECT_H
+#define RT_INJECT_H
+
+// Client library for injecting pointer events into rt-netmouse through
+// shared memory, for automated RT UI tests.
+//
+// Events go into a lock-free ring that rt-netmouse -m <name> consumes.
+// Any number of processes may write to the same ring.  Events are
+// delivered in ring order; an event scheduled for later holds back the
+// ones queued behind it.  Every event gets an id, and
+// rt_inject_fence() waits until the event with a given id, and with it
+// all earlier ones, has been sent to the RT.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RT_INJECT_DEFAULT_NAME "/rt-mouse"
+
+// Event flags
+#define RT_INJECT_BUTTONS 0x01   // set the buttons to the buttons field
+
+struct rt_inject_event {
+    uint64_t at_us;    // rt_inject_now_us() time to deliver at, 0 = at once
+    int16_t dx;
+    int16_t dy;        // positive is down
+    uint8_t buttons;   // 0x01 left, 0x02 right, 0x04 middle
+    uint8_t flags;     // RT_INJECT_*
+};
+
+typedef struct rt_inject rt_inject;
+
+// Attach to the ring of a running rt-netmouse, NULL on errors (errno set)
+rt_inject *rt_inject_open(const char *name);
+void rt_inject_close(rt_inject *inject);
+
+// Clock of the at_us fields, CLOCK_MONOTONIC in microseconds
+uint64_t rt_inject_now_us(void);
+
+// Queue a batch of events.  Returns the id of the last one, or 0 if the
+// ring has no room for all of them, in which case none was queued.
+uint64_t rt_inject_submit(rt_inject *inject, const struct rt_inject_event *events, size_t count);
+
+// Single events, delivered at once
+uint64_t rt_inject_move(rt_inject *inject, int16_t dx, int16_t dy);
+uint64_t rt_inject_buttons(rt_inject *inject, uint8_t buttons);
+
+// Wait until the event with the given id has been put on the wire, or
+// was dropped because the RT disabled the mouse.  timeout_ms < 0 waits
+// forever.  Returns 0 on success, -1 on timeout.
+int rt_inject_fence(rt_inject *inject, uint64_t id, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RT_INJECT_H
@@ -0,0 +1,50 @@
+#ifndef RT_INJECT_RING_HPP
+#define RT_INJECT_RING_HPP
+
+// Shared memory layout of the rt_inject ring.
+//
+// A bounded multi-producer queue with one consumer: every slot has a
+// sequence number that says whether it is free for position pos (seq
+// == pos) or holds the event of position pos (seq == pos + 1).
+// Producers reserve positions by advancing head with a CAS; rt-netmouse
+// frees slots in order.  The id of an event is its position plus one.
+
+#include <atomic>
+#include <cstdint>
+
+#include "rt_inject.h"
+
+constexpr uint32_t kRtInjectMagic = 0x524d494a;   // "RMIJ"
+constexpr uint32_t kRtInjectVersion = 1;
+constexpr uint64_t kRtInjectSlots = 4096;         // power of two
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring needs lock-free 64-bit atomics");
+
+struct RtInjectSlot {
+    std::atomic<uint64_t> seq;
+    rt_inject_event event;
+};
+
+struct RtInjectRing {
+    uint32_t magic;
+    uint32_t version;
+    alignas(64) std::atomic<uint64_t> head;      // next position to reserve
+    alignas(64) std::atomic<uint64_t> tail;      // next position to consume
+    std::atomic<uint32_t> consumer_waiting;      // producers must ring the doorbell
+    alignas(64) std::atomic<uint64_t> wire_id;   // last event put on the wire
+    std::atomic<uint32_t> wire_futex;            // bumped whenever wire_id changes
+    alignas(64) RtInjectSlot slots[kRtInjectSlots];
+};
+
+// Abstract Unix datagram socket the consumer waits on while the ring is
+// empty, "\0rt-inject<name>"
+inline int rt_inject_doorbell_address(const char *name, char *path, int size) {
+    path[0] = '\0';
+    int len = 1;
+    const char prefix[] = "rt-inject";
+    for (const char *p = prefix; *p && len < size; p++) path[len++] = *p;
+    for (const char *p = name; *p && len < size; p++) path[len++] = *p;
+    return len;
+}
+
+#endif // RT_INJECT_RING_HPP
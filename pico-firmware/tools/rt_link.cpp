@@ -0,0 +1,275 @@
+#include "rt_link.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// Bits per character on the RT mouse line: start, 8 data, parity, stop
+static constexpr uint32_t kBitsPerChar = 11;
+
+uint64_t monotonic_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+namespace {
+
+// Splits "tcp:host:port" into host and port, the host may be empty
+bool split_host_port(const std::string &spec, std::string &host, std::string &port) {
+    size_t colon = spec.rfind(':');
+    if (colon == std::string::npos || colon + 1 == spec.size()) {
+        return false;
+    }
+    host = spec.substr(0, colon);
+    port = spec.substr(colon + 1);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    return true;
+}
+
+bool fill_unix_addr(const std::string &path, struct sockaddr_un &addr) {
+    addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    memcpy(addr.sun_path, path.data(), path.size());
+    return true;
+}
+
+// Reports go out as soon as they are written, not when Nagle's
+// algorithm sees fit
+void set_nodelay(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+std::string errno_message(const std::string &what) {
+    return what + ": " + strerror(errno);
+}
+
+} // namespace
+
+std::unique_ptr<RtLink> RtLink::open_tty(const char *path, std::string &error) {
+    int fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        error = errno_message(path);
+        return nullptr;
+    }
+    struct termios tio;
+    if (tcgetattr(fd, &tio) < 0) {
+        error = errno_message(path);
+        ::close(fd);
+        return nullptr;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~(CSIZE | CSTOPB | CRTSCTS);
+    tio.c_cflag |= CS8 | PARENB | PARODD | CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, B9600);
+    cfsetospeed(&tio, B9600);
+    if (tcsetattr(fd, TCSANOW, &tio) < 0) {
+        error = errno_message(path);
+        ::close(fd);
+        return nullptr;
+    }
+    tcflush(fd, TCIOFLUSH);
+    return std::unique_ptr<RtLink>(new RtLink(fd, path, true));
+}
+
+std::unique_ptr<RtLink> RtLink::open(const char *spec, std::string &error) {
+    std::string s = spec;
+    if (s.compare(0, 5, "unix:") == 0) {
+        struct sockaddr_un addr;
+        if (!fill_unix_addr(s.substr(5), addr)) {
+            error = s + ": bad path";
+            return nullptr;
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            error = errno_message(s);
+            if (fd >= 0) ::close(fd);
+            return nullptr;
+        }
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        return std::unique_ptr<RtLink>(new RtLink(fd, s, false));
+    }
+    if (s.compare(0, 4, "tcp:") != 0) {
+        return open_tty(spec, error);
+    }
+
+    std::string host, port;
+    if (!split_host_port(s.substr(4), host, port)) {
+        error = s + ": expected tcp:host:port";
+        return nullptr;
+    }
+    struct addrinfo hints = {};
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *res;
+    int rc = getaddrinfo(host.empty() ? "localhost" : host.c_str(), port.c_str(), &hints, &res);
+    if (rc != 0) {
+        error = s + ": " + gai_strerror(rc);
+        return nullptr;
+    }
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        error = errno_message(s);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        return nullptr;
+    }
+    set_nodelay(fd);
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return std::unique_ptr<RtLink>(new RtLink(fd, s, false));
+}
+
+RtLink::RtLink(int fd, std::string name, bool tty) : fd_(fd), name_(std::move(name)), tty_(tty) {}
+
+RtLink::~RtLink() {
+    ::close(fd_);
+}
+
+void RtLink::set_baud(uint32_t baud) {
+    char_us_ = baud ? (kBitsPerChar * 1000000 + baud - 1) / baud : 0;
+}
+
+void RtLink::queue(const uint8_t *data, size_t len) {
+    if (!char_us_) {
+        ready_.insert(ready_.end(), data, data + len);
+        return;
+    }
+    if (paced_.empty()) {
+        // The modelled transmitter starts on the first byte queued while
+        // it is idle
+        uint64_t now_us = monotonic_us();
+        if (tx_end_us_ < now_us) {
+            tx_end_us_ = now_us;
+        }
+    }
+    paced_.insert(paced_.end(), data, data + len);
+}
+
+uint64_t RtLink::next_flush_us() const {
+    return paced_.empty() ? UINT64_MAX : tx_end_us_ + char_us_;
+}
+
+bool RtLink::flush() {
+    if (!paced_.empty()) {
+        uint64_t now_us = monotonic_us();
+        size_t due = 0;
+        while (due < paced_.size() && tx_end_us_ + char_us_ <= now_us) {
+            tx_end_us_ += char_us_;
+            due++;
+        }
+        ready_.insert(ready_.end(), paced_.begin(), paced_.begin() + due);
+        paced_.erase(paced_.begin(), paced_.begin() + due);
+    }
+    while (!ready_.empty()) {
+        ssize_t n = ::write(fd_, ready_.data(), ready_.size());
+        if (n < 0) {
+            return errno == EAGAIN || errno == EINTR;
+        }
+        ready_.erase(ready_.begin(), ready_.begin() + n);
+    }
+    return true;
+}
+
+bool RtLink::idle() const {
+    if (!paced_.empty() || !ready_.empty()) {
+        return false;
+    }
+    // Serial ports and sockets both report what the kernel still holds;
+    // for a socket that is what the emulator has not read yet
+    int pending = 0;
+    return ioctl(fd_, TIOCOUTQ, &pending) < 0 || pending == 0;
+}
+
+long RtLink::read(uint8_t *buf, size_t len) {
+    ssize_t n = ::read(fd_, buf, len);
+    return n < 0 && errno != EAGAIN && errno != EINTR ? -2 : n < 0 ? -1 : n;
+}
+
+std::unique_ptr<RtListener> RtListener::open(const char *spec, std::string &error) {
+    std::string s = spec;
+    if (s.compare(0, 5, "unix:") == 0) {
+        std::string path = s.substr(5);
+        struct sockaddr_un addr;
+        if (!fill_unix_addr(path, addr)) {
+            error = s + ": bad path";
+            return nullptr;
+        }
+        unlink(path.c_str());
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+            error = errno_message(s);
+            if (fd >= 0) ::close(fd);
+            return nullptr;
+        }
+        return std::unique_ptr<RtListener>(new RtListener(fd, s, path));
+    }
+
+    std::string host, port;
+    if (s.compare(0, 4, "tcp:") != 0 || !split_host_port(s.substr(4), host, port)) {
+        error = s + ": expected tcp:[host]:port or unix:path";
+        return nullptr;
+    }
+    struct addrinfo hints = {};
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    struct addrinfo *res;
+    int rc = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &res);
+    if (rc != 0) {
+        error = s + ": " + gai_strerror(rc);
+        return nullptr;
+    }
+    int fd = socket(res->ai_family, res->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, res->ai_protocol);
+    int one = 1;
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+        bind(fd, res->ai_addr, res->ai_addrlen) < 0 || listen(fd, 64) < 0) {
+        error = errno_message(s);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        return nullptr;
+    }
+    return std::unique_ptr<RtListener>(new RtListener(fd, s, ""));
+}
+
+RtListener::~RtListener() {
+    ::close(fd_);
+    if (!unix_path_.empty()) {
+        unlink(unix_path_.c_str());
+    }
+}
+
+std::unique_ptr<RtLink> RtListener::accept() {
+    int fd = accept4(fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    if (unix_path_.empty()) {
+        set_nodelay(fd);
+    }
+    return std::unique_ptr<RtLink>(new RtLink(fd, name_ + "#" + std::to_string(++accepted_), false));
+}
@@ -0,0 +1,96 @@
+#ifndef RT_LINK_HPP
+#define RT_LINK_HPP
+
+// Byte link to an RT, for the host tools: a serial port, or a TCP or
+// Unix stream socket to an RT emulator.  Writes are queued and handed
+// to the kernel in batches, idle() tells the pacer when everything has
+// actually left so that motion can be bound to a report as late as
+// possible.
+//
+// A socket has no line speed of its own.  With set_baud() the link
+// models an 8O1 transmitter instead: every byte is handed over when its
+// stop bit would have ended, 11 bit times after the previous one, so an
+// emulator sees the timing of a real mouse line.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Monotonic clock in microseconds
+uint64_t monotonic_us();
+
+class RtLink {
+public:
+    // Serial port set up like the RT mouse line, 9600 baud 8O1
+    static std::unique_ptr<RtLink> open_tty(const char *path, std::string &error);
+    // "tcp:host:port" or "unix:path" connects to an emulator, anything
+    // else is a serial port
+    static std::unique_ptr<RtLink> open(const char *spec, std::string &error);
+
+    ~RtLink();
+    RtLink(const RtLink &) = delete;
+    RtLink &operator=(const RtLink &) = delete;
+
+    int fd() const { return fd_; }
+    const std::string &name() const { return name_; }
+    bool is_tty() const { return tty_; }
+
+    // Model a transmitter at this many baud, 0 = hand bytes over at once
+    void set_baud(uint32_t baud);
+
+    void queue(const uint8_t *data, size_t len);
+    // Write as much of the queue as is due and the kernel takes, false
+    // on errors
+    bool flush();
+    bool want_write() const { return !ready_.empty(); }
+    // When the next modelled byte is due, UINT64_MAX if none is waiting
+    uint64_t next_flush_us() const;
+    // Nothing left in the queue nor in the kernel's output buffer
+    bool idle() const;
+    // Read received bytes, 0 on end of file, -1 if there is nothing to
+    // read, -2 on errors
+    long read(uint8_t *buf, size_t len);
+
+private:
+    friend class RtListener;
+
+    RtLink(int fd, std::string name, bool tty);
+
+    int fd_;
+    std::string name_;
+    bool tty_;
+    uint32_t char_us_ = 0;         // modelled character time, 0 = off
+    uint64_t tx_end_us_ = 0;       // end of the last modelled character
+    std::vector<uint8_t> paced_;   // waiting for the modelled transmitter
+    std::vector<uint8_t> ready_;   // waiting for the kernel
+};
+
+// Listening socket that emulators connect to, "tcp:[host]:port" or
+// "unix:path"; every connection is one RT
+class RtListener {
+public:
+    static std::unique_ptr<RtListener> open(const char *spec, std::string &error);
+
+    ~RtListener();
+    RtListener(const RtListener &) = delete;
+    RtListener &operator=(const RtListener &) = delete;
+
+    int fd() const { return fd_; }
+    const std::string &name() const { return name_; }
+
+    // Next pending connection, nullptr if there is none
+    std::unique_ptr<RtLink> accept();
+
+private:
+    RtListener(int fd, std::string name, std::string unix_path)
+        : fd_(fd), name_(std::move(name)), unix_path_(std::move(unix_path)) {}
+
+    int fd_;
+    std::string name_;
+    std::string unix_path_;
+    unsigned accepted_ = 0;
+};
+
+#endif // RT_LINK_HPP
@@ -0,0 +1,180 @@
+// Host test of rt-netmouse's pointer (net_mouse.hpp): datagrams pushed
+// into a client's jitter buffer, released into an RT session, and the
+// data reports that come out at the other end of a Unix socket link.
+//
+//   ctest --test-dir tools/build
+
+#include <endian.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "net_mouse.hpp"
+
+namespace {
+
+int failures;
+const char *current_test;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            fprintf(stderr, "%s:%d: %s: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                    current_test, #cond);                                        \
+            failures++;                                                          \
+        }                                                                        \
+    } while (0)
+
+struct Report {
+    uint8_t buttons;   // RT status byte button bits
+    int8_t dx;
+    int8_t dy;
+};
+
+// One NetMouse with one RT, the RT end of the link is read by the test
+class Rig {
+public:
+    Rig() {
+        std::string error;
+        path_ = "/tmp/rt-netmouse-test-" + std::to_string(getpid());
+        std::string spec = "unix:" + path_;
+        listener_ = RtListener::open(spec.c_str(), error);
+        rt_end_ = RtLink::open(spec.c_str(), error);
+        std::unique_ptr<RtLink> link = listener_ ? listener_->accept() : nullptr;
+        if (!rt_end_ || !link) {
+            fprintf(stderr, "%s: %s\n", spec.c_str(), error.c_str());
+            exit(1);
+        }
+        rt_ = &mouse_.add_rt(std::move(link), 0);
+    }
+
+    ~Rig() {
+        unlink(path_.c_str());
+    }
+
+    void push(uint16_t seq, uint32_t time_us, uint8_t buttons, int16_t dx = 0, int16_t dy = 0) {
+        NetMotion m = {};
+        m.magic = htole16(NET_MOTION_MAGIC);
+        m.version = NET_MOTION_VERSION;
+        m.buttons = buttons;
+        m.seq = htole16(seq);
+        m.time_us = htole32(time_us);
+        m.dx = (int16_t)htole16((uint16_t)dx);
+        m.dy = (int16_t)htole16((uint16_t)dy);
+        mouse_.push("test#0", m, now_us_);
+    }
+
+    // One release() call once everything pushed is due, then the reports
+    // the session sends one sample period apart
+    std::vector<Report> run() {
+        now_us_ += 200000;
+        mouse_.release(now_us_);
+        std::vector<Report> reports;
+        for (int i = 0; i < 16; i++) {
+            rt_->session.service(now_us_);
+            rt_->link->flush();
+            uint8_t buf[64];
+            long n;
+            while ((n = rt_end_->read(buf, sizeof(buf))) > 0) {
+                received_.insert(received_.end(), buf, buf + n);
+            }
+            now_us_ += rt_->session.state().sample_rate ? 1000000 / rt_->session.state().sample_rate : 10000;
+        }
+        for (size_t i = 0; i + 4 <= received_.size(); i += 4) {
+            if (received_[i] == RT_MOUSE_DATA_REPORT) {
+                // y is sent positive up
+                reports.push_back({ (uint8_t)(received_[i + 1] & 0xe0), (int8_t)received_[i + 2],
+                                    (int8_t)-(int8_t)received_[i + 3] });
+            }
+        }
+        received_.clear();
+        return reports;
+    }
+
+private:
+    std::string path_;
+    std::unique_ptr<RtListener> listener_;
+    std::unique_ptr<RtLink> rt_end_;
+    NetMouse mouse_{ JitterConfig() };
+    Rt *rt_ = nullptr;
+    uint64_t now_us_ = 1000000;
+    std::vector<uint8_t> received_;
+};
+
+constexpr uint8_t kLeft = 0x20;   // RT status byte
+
+void test_click_in_one_release() {
+    current_test = "click in one release";
+    Rig rig;
+    rig.push(0, 0, RT_BUTTON_LEFT);
+    rig.push(1, 1000, 0);
+    std::vector<Report> reports = rig.run();
+    CHECK(reports.size() == 2);
+    if (reports.size() == 2) {
+        CHECK(reports[0].buttons == kLeft);
+        CHECK(reports[1].buttons == 0);
+    }
+}
+
+void test_click_then_move() {
+    current_test = "click then move";
+    Rig rig;
+    rig.push(0, 0, 0, 3, 0);
+    rig.push(1, 1000, RT_BUTTON_LEFT);
+    rig.push(2, 2000, 0, 5, -2);
+    std::vector<Report> reports = rig.run();
+    CHECK(reports.size() == 3);
+    if (reports.size() == 3) {
+        CHECK(reports[0].buttons == 0 && reports[0].dx == 3);
+        CHECK(reports[1].buttons == kLeft && reports[1].dx == 0 && reports[1].dy == 0);
+        // Not a drag
+        CHECK(reports[2].buttons == 0 && reports[2].dx == 5 && reports[2].dy == -2);
+    }
+}
+
+void test_double_click() {
+    current_test = "double click";
+    Rig rig;
+    rig.push(0, 0, RT_BUTTON_LEFT);
+    rig.push(1, 1000, 0);
+    rig.push(2, 2000, RT_BUTTON_LEFT);
+    rig.push(3, 3000, 0);
+    std::vector<Report> reports = rig.run();
+    CHECK(reports.size() == 4);
+    if (reports.size() == 4) {
+        CHECK(reports[0].buttons == kLeft && reports[1].buttons == 0);
+        CHECK(reports[2].buttons == kLeft && reports[3].buttons == 0);
+    }
+}
+
+void test_client_restart() {
+    current_test = "client restart";
+    Rig rig;
+    rig.push(5000, 10000000, 0, 1, 0);
+    CHECK(rig.run().size() == 1);
+    // Relaunched: sequence and clock start again
+    rig.push(0, 100, RT_BUTTON_LEFT);
+    rig.push(1, 1100, 0);
+    std::vector<Report> reports = rig.run();
+    CHECK(reports.size() == 2);
+    if (reports.size() == 2) {
+        CHECK(reports[0].buttons == kLeft && reports[1].buttons == 0);
+    }
+}
+
+} // namespace
+
+int main() {
+    test_click_in_one_release();
+    test_click_then_move();
+    test_double_click();
+    test_client_restart();
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All netmouse tests passed\n");
+    return 0;
+}
@@ -0,0 +1,272 @@
+// Host test of the protocol engine (rt_protocol.hpp): command sequences
+// as the RT sends them, checked against the responses, state and
+// counters the firmware has always produced, and data report encoding.
+//
+//   ctest --test-dir tools/build
+
+#include <cstdio>
+#include <vector>
+
+#include "rt_protocol.hpp"
+
+namespace {
+
+int failures;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            fprintf(stderr, "%s:%d: %s: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                    current_test, #cond);                                        \
+            failures++;                                                          \
+        }                                                                        \
+    } while (0)
+
+const char *current_test;
+
+using Bytes = std::vector<uint8_t>;
+
+struct TestTransport {
+    Bytes responses;
+    std::vector<Bytes> reports;
+    bool accept_reports = true;
+
+    void send_response(const uint8_t *data, size_t len) {
+        responses.insert(responses.end(), data, data + len);
+    }
+
+    bool send_report(const uint8_t *data, size_t len) {
+        if (!accept_reports) {
+            return false;
+        }
+        reports.emplace_back(data, data + len);
+        return true;
+    }
+};
+
+// Time is advanced by the test
+uint32_t test_now_us;
+
+struct TestClock {
+    uint32_t now_us() const {
+        return test_now_us;
+    }
+};
+
+template <class Scaling = rt::LinearScaling, class Buttons = rt::UsbButtonMap, class Format = rt::RtReportFormat>
+using TestEngine = rt::ProtocolEngine<TestTransport, TestClock, Scaling, rt::SampleRatePacing, Buttons, Format>;
+
+// Feed bytes 1 ms apart, returns the OR of the events
+template <class Engine>
+uint32_t feed(Engine &engine, const Bytes &bytes) {
+    uint32_t events = 0;
+    for (uint8_t byte : bytes) {
+        test_now_us += 1000;
+        events |= engine.handle_byte(byte);
+    }
+    return events;
+}
+
+// Responses since the last call
+template <class Engine>
+Bytes take_responses(Engine &engine) {
+    Bytes responses;
+    responses.swap(engine.transport().responses);
+    return responses;
+}
+
+void test_reset_and_config() {
+    current_test = "reset and config";
+    TestEngine<> engine;
+    CHECK(feed(engine, { MOUSE_CMD_RESET }) == RT_EVENT_RESET);
+    CHECK(take_responses(engine) == Bytes({ RT_MOUSE_RESET_ACK, 0x08, 0x00, 0x00 }));
+    CHECK(!engine.state().initialized);
+    CHECK(engine.state().enabled);
+    CHECK(feed(engine, { MOUSE_CMD_READ_CONFIG }) == 0);
+    CHECK(take_responses(engine) == Bytes({ RT_MOUSE_CONFIGURED, 0x00, 0x00, 0x00 }));
+    CHECK(engine.state().initialized);
+    CHECK(engine.state().last_command == MOUSE_CMD_READ_CONFIG);
+}
+
+void test_settings_and_status() {
+    current_test = "settings and status";
+    TestEngine<> engine;
+    CHECK(feed(engine, { MOUSE_CMD_DISABLE }) == RT_EVENT_DISABLE);
+    CHECK(feed(engine, { MOUSE_CMD_SET_RATE, 40, MOUSE_CMD_SET_RESOLUTION, 0x02,
+                         MOUSE_CMD_SET_MODE, 0x03, MOUSE_CMD_SET_SCALE_EXP }) == 0);
+    CHECK(engine.state().sample_rate == 40);
+    CHECK(engine.state().resolution == 0x02);
+    CHECK(engine.state().mode == 'r');
+    CHECK(engine.state().scaling == 'e');
+    CHECK(engine.report_interval_us() == 25000);
+    feed(engine, { MOUSE_CMD_READ_STATUS });
+    CHECK(take_responses(engine) == Bytes({ RT_MOUSE_STATUS_REPORT, 0x20 | 0x10 | 0x08 | 0x04, 0x02, 40 }));
+    CHECK(feed(engine, { MOUSE_CMD_ENABLE, MOUSE_CMD_SET_SCALE_LIN, MOUSE_CMD_SET_MODE, 0x00 }) == RT_EVENT_ENABLE);
+    feed(engine, { MOUSE_CMD_READ_STATUS });
+    CHECK(take_responses(engine) == Bytes({ RT_MOUSE_STATUS_REPORT, 0x04, 0x02, 40 }));
+    CHECK(feed(engine, { MOUSE_CMD_READ_DATA }) == RT_EVENT_READ_DATA);
+    CHECK(engine.stats().cmd_unknown == 0 && engine.stats().cmd_bad_params == 0);
+}
+
+void test_wrap_mode() {
+    current_test = "wrap mode";
+    TestEngine<> engine;
+    feed(engine, { MOUSE_CMD_WRAP_ON, 0x55, MOUSE_CMD_READ_STATUS, MOUSE_CMD_SET_RATE });
+    CHECK(take_responses(engine) == Bytes({ 0x55, MOUSE_CMD_READ_STATUS, MOUSE_CMD_SET_RATE }));
+    CHECK(engine.stats().wrap_echoes == 3);
+    CHECK(engine.state().sample_rate == 100);
+    feed(engine, { MOUSE_CMD_WRAP_OFF, MOUSE_CMD_READ_STATUS });
+    CHECK(take_responses(engine).size() == 4);
+    // RESET ends wrap mode and is answered
+    feed(engine, { MOUSE_CMD_WRAP_ON });
+    CHECK(feed(engine, { MOUSE_CMD_RESET }) == RT_EVENT_RESET);
+    CHECK(take_responses(engine) == Bytes({ RT_MOUSE_RESET_ACK, 0x08, 0x00, 0x00 }));
+    CHECK(!engine.state().wrap_mode);
+}
+
+void test_bad_parameters() {
+    current_test = "bad parameters";
+    TestEngine<> engine;
+    // Not a rate and not a command
+    feed(engine, { MOUSE_CMD_SET_RATE, 0x07 });
+    CHECK(engine.stats().cmd_bad_params == 1);
+    CHECK(engine.stats().cmd_unknown == 1);
+    CHECK(engine.state().sample_rate == 100);
+    // Parameter lost: the next command is recognized as such
+    CHECK(feed(engine, { MOUSE_CMD_SET_RESOLUTION, MOUSE_CMD_ENABLE }) == RT_EVENT_ENABLE);
+    CHECK(engine.stats().cmd_bad_params == 2);
+    CHECK(engine.state().resolution == 100);
+    // Line error in the middle of a command
+    feed(engine, { MOUSE_CMD_SET_RATE });
+    engine.line_error();
+    feed(engine, { 20 });
+    CHECK(engine.stats().cmd_discarded == 1);
+    CHECK(engine.state().sample_rate == 100);
+    feed(engine, { MOUSE_CMD_SET_RATE, 20 });
+    CHECK(engine.state().sample_rate == 20);
+    CHECK(engine.stats().recovery_pending_done);
+}
+
+void test_parameter_timeout() {
+    current_test = "parameter timeout";
+    TestEngine<> engine;
+    feed(engine, { MOUSE_CMD_SET_RATE });
+    test_now_us += rt::kDefaultCommandTimeoutUs;
+    // Late: not taken as the rate, and the command is no longer pending
+    // for the byte after it either
+    feed(engine, { 40, 20 });
+    CHECK(engine.stats().cmd_timeouts == 1);
+    CHECK(engine.stats().cmd_unknown == 2);
+    CHECK(engine.state().sample_rate == 100);
+    feed(engine, { MOUSE_CMD_SET_RATE, 60 });
+    CHECK(engine.state().sample_rate == 60);
+
+    // The same for every command with a parameter: after the timeout an
+    // unknown byte, then one that would be a valid parameter
+    const uint8_t commands[][2] = {
+        { MOUSE_CMD_SET_RATE, 200 },
+        { MOUSE_CMD_SET_MODE, 0x03 },
+        { MOUSE_CMD_SET_RESOLUTION, 0x02 },
+    };
+    for (const auto &command : commands) {
+        TestEngine<> stale;
+        feed(stale, { command[0] });
+        test_now_us += rt::kDefaultCommandTimeoutUs;
+        feed(stale, { 0x55, command[1] });
+        CHECK(stale.stats().cmd_timeouts == 1);
+        CHECK(stale.state().sample_rate == 100);
+        CHECK(stale.state().mode == 's');
+        CHECK(stale.state().resolution == 100);
+        CHECK(stale.state().last_command == 0);
+    }
+}
+
+void test_report_encoding() {
+    current_test = "report encoding";
+    TestEngine<> engine;
+    int32_t dx = -5;
+    int32_t dy = 3;
+    CHECK(engine.send_report(RT_BUTTON_LEFT | RT_BUTTON_MIDDLE, dx, dy));
+    // y is sent positive up
+    CHECK(engine.transport().reports.back() == Bytes({ RT_MOUSE_DATA_REPORT, 0x20 | 0x40 | 0x04 | 0x02, 0xfb, 0xfd }));
+    CHECK(dx == 0 && dy == 0);
+
+    // Motion beyond one report is carried over
+    dx = 300;
+    dy = -130;
+    int32_t sent_x = 0;
+    int32_t sent_y = 0;
+    while (dx || dy) {
+        engine.send_report(0, dx, dy);
+        sent_x += (int8_t)engine.transport().reports.back()[2];
+        sent_y += (int8_t)engine.transport().reports.back()[3];
+    }
+    CHECK(sent_x == 300 && sent_y == 130);
+
+    // Not consumed when the transport refuses the report
+    engine.transport().accept_reports = false;
+    dx = 10;
+    CHECK(!engine.send_report(0, dx, dy));
+    CHECK(dx == 10);
+}
+
+void test_exponential_carry() {
+    current_test = "exponential carry";
+    TestEngine<rt::RtSelectedScaling<rt::ExponentialCurve>> engine;
+    feed(engine, { MOUSE_CMD_SET_SCALE_EXP });
+    int32_t dx = 200;
+    int32_t dy = -3;
+    int32_t sent_x = 0;
+    int32_t sent_y = 0;
+    std::vector<int> report_x;
+    while (dx || dy) {
+        engine.send_report(0, dx, dy);
+        const Bytes &report = engine.transport().reports.back();
+        report_x.push_back((int8_t)report[2]);
+        sent_x += (int8_t)report[2];
+        sent_y += (int8_t)report[3];
+    }
+    // Doubled, none of it lost to clamping: full reports of the largest
+    // input the curve fits into 127, then the rest
+    CHECK(report_x == std::vector<int>({ 126, 126, 126, 22 }));
+    CHECK(sent_x == 400);
+    CHECK(sent_y == 3);
+}
+
+void test_button_maps_and_ps2() {
+    current_test = "button maps and PS/2";
+    TestEngine<rt::LinearScaling, rt::ChordMiddleButtonMap> chord;
+    int32_t dx = 0;
+    int32_t dy = 0;
+    chord.send_report(RT_BUTTON_LEFT | RT_BUTTON_RIGHT, dx, dy);
+    CHECK(chord.transport().reports.back()[1] == 0x40);
+    TestEngine<rt::LinearScaling, rt::LeftHandedButtonMap> left;
+    left.send_report(RT_BUTTON_LEFT, dx, dy);
+    CHECK(left.transport().reports.back()[1] == 0x80);
+
+    TestEngine<rt::LinearScaling, rt::UsbButtonMap, rt::Ps2ReportFormat> ps2;
+    dx = 300;
+    dy = 1;
+    ps2.send_report(RT_BUTTON_RIGHT, dx, dy);
+    CHECK(ps2.transport().reports.back() == Bytes({ 0x08 | 0x02 | 0x20, 0xff, 0xff }));
+    CHECK(dx == 45 && dy == 0);
+}
+
+} // namespace
+
+int main() {
+    test_reset_and_config();
+    test_settings_and_status();
+    test_wrap_mode();
+    test_bad_parameters();
+    test_parameter_timeout();
+    test_report_encoding();
+    test_exponential_carry();
+    test_button_maps_and_ps2();
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All protocol engine tests passed\n");
+    return 0;
+}
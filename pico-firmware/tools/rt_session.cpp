@@ -0,0 +1,87 @@
+#include "rt_session.hpp"
+
+#include <algorithm>
+
+RtSession::RtSession(RtLink &link) : link_(link), engine_(LinkTransport{ &link }) {}
+
+void RtSession::receive(const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        uint32_t events = engine_.handle_byte(data[i]);
+        if (events & (RT_EVENT_RESET | RT_EVENT_DISABLE)) {
+            for (const Pending &pending : pending_) {
+                sent_tag_ = std::max(sent_tag_, pending.tag);
+            }
+            pending_.clear();
+        }
+        if (events & RT_EVENT_READ_DATA) {
+            read_data_ = true;
+        }
+    }
+}
+
+void RtSession::add_motion(int32_t dx, int32_t dy, uint64_t released_us, uint64_t tag) {
+    if (engine_.state().enabled && (dx || dy)) {
+        if (pending_.empty()) {
+            oldest_released_us_ = released_us;
+            pending_.push_back({ buttons_, 0, 0, 0 });
+        }
+        pending_.back().dx += dx;
+        pending_.back().dy += dy;
+    }
+    add_tag(tag);
+}
+
+void RtSession::set_buttons(uint8_t buttons, uint64_t released_us, uint64_t tag) {
+    if (buttons != buttons_ && engine_.state().enabled) {
+        if (pending_.empty()) {
+            oldest_released_us_ = released_us;
+        }
+        if (pending_.size() < kMaxPending) {
+            pending_.push_back({ buttons, 0, 0, 0 });
+        } else {
+            pending_.back().buttons = buttons;
+        }
+        buttons_ = buttons;
+    }
+    add_tag(tag);
+}
+
+uint64_t RtSession::service(uint64_t now_us) {
+    const MouseState &state = engine_.state();
+    uint64_t interval_us = engine_.report_interval_us();
+    if (state.wrap_mode) {
+        return now_us + interval_us;
+    }
+    if (!link_.idle()) {
+        // Check again in about one character time
+        return now_us + 1000;
+    }
+    if (read_data_) {
+        read_data_ = false;
+    } else {
+        if (!state.enabled || pending_.empty()) {
+            return now_us + interval_us;
+        }
+        if (now_us - last_sent_us_ < interval_us) {
+            return last_sent_us_ + interval_us;
+        }
+    }
+    if (pending_.empty()) {
+        // READ_DATA with nothing pending
+        int32_t dx = 0;
+        int32_t dy = 0;
+        engine_.send_report(buttons_, dx, dy);
+    } else {
+        wire_delay_.add(now_us - oldest_released_us_);
+        Pending &pending = pending_.front();
+        engine_.send_report(pending.buttons, pending.dx, pending.dy);
+        if (!pending.dx && !pending.dy) {
+            sent_tag_ = std::max(sent_tag_, pending.tag);
+            pending_.pop_front();
+        }
+    }
+    reports_++;
+    last_sent_us_ = now_us;
+    oldest_released_us_ = now_us;
+    return now_us + interval_us;
+}
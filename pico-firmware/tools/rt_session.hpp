@@ -0,0 +1,115 @@
+#ifndef RT_SESSION_HPP
+#define RT_SESSION_HPP
+
+// One emulated RT mouse on the host: the protocol engine answering the
+// RT's commands on a link, and a pacer that turns accumulated motion
+// into data reports the way the firmware does.  Motion is sent at most
+// once per sample period, only when the link is idle, and motion beyond
+// the range of one report is carried over.
+//
+// Every button change starts a report of its own, sent after all motion
+// before it.  A press released again before the next sample still gets
+// a press report and then a release report, and motion after a click is
+// not sent with the button down.
+
+#include <cstdint>
+#include <deque>
+
+#include "rt_protocol.hpp"
+#include "rt_link.hpp"
+
+// min/avg/max of a duration in microseconds
+struct DelayStats {
+    uint64_t count = 0;
+    uint64_t total = 0;
+    uint64_t min = 0;
+    uint64_t max = 0;
+
+    void add(uint64_t value) {
+        if (!count || value < min) min = value;
+        if (value > max) max = value;
+        total += value;
+        count++;
+    }
+
+    uint64_t avg() const { return count ? total / count : 0; }
+};
+
+class RtSession {
+public:
+    explicit RtSession(RtLink &link);
+
+    RtLink &link() { return link_; }
+
+    // Bytes received from the RT
+    void receive(const uint8_t *data, size_t len);
+
+    // Motion in USB orientation (y positive is down), released_us is
+    // when it left the input queue, for the to-wire delay statistics.
+    // A non-zero tag is reported by sent_tag() once the change is sent;
+    // tags must not decrease.
+    void add_motion(int32_t dx, int32_t dy, uint64_t released_us, uint64_t tag = 0);
+    // USB boot protocol button bits
+    void set_buttons(uint8_t buttons, uint64_t released_us, uint64_t tag = 0);
+
+    // Send a report if one is due, returns the time of the next check
+    uint64_t service(uint64_t now_us);
+
+    const MouseState &state() const { return engine_.state(); }
+    const RtProtocolStats &protocol_stats() const { return engine_.stats(); }
+    uint64_t reports() const { return reports_; }
+    // Highest tag whose change has been queued on the link in full, or
+    // was dropped because the RT disabled the mouse.  Once the link is
+    // idle it is on the wire.
+    uint64_t sent_tag() const { return sent_tag_; }
+    // Motion released from an input queue to the report carrying it
+    const DelayStats &wire_delay() const { return wire_delay_; }
+
+private:
+    struct LinkTransport {
+        RtLink *link;
+
+        void send_response(const uint8_t *data, size_t len) { link->queue(data, len); }
+        bool send_report(const uint8_t *data, size_t len) {
+            link->queue(data, len);
+            return true;
+        }
+    };
+
+    struct HostClock {
+        uint32_t now_us() const { return (uint32_t)monotonic_us(); }
+    };
+
+    // One report's worth of changes, more if the motion does not fit
+    struct Pending {
+        uint8_t buttons;
+        int32_t dx;
+        int32_t dy;
+        uint64_t tag;
+    };
+
+    // Beyond this many button changes waiting, the newest ones are merged
+    static constexpr size_t kMaxPending = 32;
+
+    void add_tag(uint64_t tag) {
+        if (tag) {
+            (pending_.empty() ? sent_tag_ : pending_.back().tag) = tag;
+        }
+    }
+
+    using Engine = rt::ProtocolEngine<LinkTransport, HostClock, rt::LinearScaling,
+                                      rt::SampleRatePacing, rt::UsbButtonMap, rt::RtReportFormat>;
+
+    RtLink &link_;
+    Engine engine_;
+    std::deque<Pending> pending_;   // front goes out next
+    uint8_t buttons_ = 0;           // of the newest change
+    bool read_data_ = false;
+    uint64_t sent_tag_ = 0;
+    uint64_t oldest_released_us_ = 0;
+    uint64_t last_sent_us_ = 0;
+    uint64_t reports_ = 0;
+    DelayStats wire_delay_;
+};
+
+#endif // RT_SESSION_HPP
@@ -0,0 +1,57 @@
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+// Trace file format, shared between the firmware's USB stick logger and
+// the rt-trace host tool.  The file is preallocated and made of fixed
+// size blocks, so it can be memory-mapped and indexed directly:
+//
+//   block 0                      struct TraceFileHeader, zero padded
+//   block 1 .. blocks            struct TraceBlockHeader, then count
+//                                struct FlightEvent records
+//
+// Data blocks are written in a circle, block seq goes to 1 + seq %
+// blocks, so a long run keeps its most recent part.  Blocks that do not
+// carry the file's session are left over from earlier contents of the
+// stick and must be ignored.
+
+#include <stdint.h>
+
+#include "flight_recorder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACE_FILE_MAGIC "RTTRACE1"
+#define TRACE_FILE_VERSION 1
+#define TRACE_BLOCK_MAGIC 0x42545452   // "RTTB"
+#define TRACE_BLOCK_SIZE 8192          // 16 sectors
+
+struct TraceFileHeader {
+    char magic[8];                 // TRACE_FILE_MAGIC, not terminated
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t blocks;               // data blocks after the header block
+    uint32_t session;
+    uint32_t block_header_size;
+    uint32_t record_size;
+};
+
+struct TraceBlockHeader {
+    uint32_t magic;                // TRACE_BLOCK_MAGIC
+    uint32_t seq;                  // data blocks written before this one
+    uint32_t session;
+    uint16_t count;                // records in this block
+    uint16_t dropped;              // events lost right before the first record
+    uint64_t start_us;             // 64-bit time of the first record, the
+                                   // records carry the low 32 bits
+};
+
+#define TRACE_BLOCK_RECORDS \
+    ((TRACE_BLOCK_SIZE - sizeof(struct TraceBlockHeader)) / sizeof(struct FlightEvent))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_FILE_H
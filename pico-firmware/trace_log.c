@@ -0,0 +1,457 @@
+#include <stdio.h>
+#include <tusb.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "trace_file.h"
+#include "trace_log.h"
+
+// Trace logger configuration.  The file is preallocated with
+// RT_TRACE_FILE_MB, or half the free space if that is less; a busy
+// 1 kHz mouse fills about 1 GB per day.  A partial staging buffer is
+// written after RT_TRACE_FLUSH_US so that an unplugged stick loses at
+// most that much.
+#ifndef RT_TRACE_LOG
+#define RT_TRACE_LOG 1
+#endif
+#ifndef RT_TRACE_FILE_MB
+#define RT_TRACE_FILE_MB 2048
+#endif
+#define RT_TRACE_MIN_FILE_MB 1
+#define RT_TRACE_FLUSH_US 2000000
+#define RT_TRACE_SECTOR_SIZE 512
+#define RT_TRACE_SECTORS_PER_BLOCK (TRACE_BLOCK_SIZE / RT_TRACE_SECTOR_SIZE)
+
+// Staging buffer states.  fr_record fills one buffer while the other is
+// written, the states only change with interrupts disabled.
+enum TraceBufferState {
+    TRACE_BUFFER_FREE,
+    TRACE_BUFFER_FILLING,
+    TRACE_BUFFER_READY,      // closed, waiting for the stick
+    TRACE_BUFFER_WRITING,
+};
+
+struct TraceBuffer {
+    union {
+        struct TraceBlockHeader header;
+        uint8_t data[TRACE_BLOCK_SIZE];
+    };
+    volatile uint8_t state;
+};
+
+struct TraceLog {
+    bool enabled;
+    volatile bool active;           // file ready, events are staged
+    uint8_t dev_addr;               // mounted stick, 0 = none
+    bool failed;                    // no file on this stick, wait for the next one
+    char file_name[13];
+    uint32_t session;
+    uint32_t data_lba;              // first sector of data block 0
+    uint32_t blocks;
+    uint32_t next_seq;
+    volatile uint8_t fill;          // buffer fr_record appends to
+    volatile bool write_busy;
+    uint8_t writing;                // buffer of the write in flight
+    uint32_t write_start_us;
+    volatile uint32_t dropped;      // events lost since the last block started
+    uint32_t dropped_total;
+    uint32_t blocks_written;
+    uint32_t partial_blocks;
+    uint32_t write_errors;
+    uint32_t write_max_us;
+};
+
+static struct TraceLog trace_log = {
+    .enabled = RT_TRACE_LOG,
+};
+
+static struct TraceBuffer trace_buffers[2] __attribute__((aligned(4)));
+
+static FATFS trace_fs;
+
+static void (*trace_service)(void);
+
+static volatile bool disk_busy;
+static volatile bool disk_ok;
+
+void trace_log_init(void (*service)(void)) {
+    trace_service = service;
+}
+
+//--------------------------------------------------------------------
+// Staging, interrupt and thread context
+//--------------------------------------------------------------------
+
+// Start filling a free buffer.  Must be called with interrupts disabled.
+static void __not_in_flash_func(trace_buffer_start)(uint8_t index) {
+    struct TraceBuffer *buffer = &trace_buffers[index];
+    uint32_t dropped = trace_log.dropped < 0xffff ? trace_log.dropped : 0xffff;
+    buffer->header = (struct TraceBlockHeader) {
+        .magic = TRACE_BLOCK_MAGIC,
+        .session = trace_log.session,
+        .dropped = (uint16_t)dropped,
+    };
+    buffer->state = TRACE_BUFFER_FILLING;
+    trace_log.dropped = 0;
+    trace_log.fill = index;
+}
+
+// Close the buffer being filled and move on to the other one if it is
+// free.  Otherwise events are dropped until the write in flight is
+// done.  Must be called with interrupts disabled.
+static void __not_in_flash_func(trace_buffer_close)(void) {
+    trace_buffers[trace_log.fill].state = TRACE_BUFFER_READY;
+    uint8_t other = trace_log.fill ^ 1;
+    if (trace_buffers[other].state == TRACE_BUFFER_FREE) {
+        trace_buffer_start(other);
+    }
+}
+
+void __not_in_flash_func(trace_log_record)(const struct FlightEvent *event) {
+    if (!trace_log.active) {
+        return;
+    }
+    struct TraceBuffer *buffer = &trace_buffers[trace_log.fill];
+    if (buffer->state != TRACE_BUFFER_FILLING) {
+        trace_log.dropped++;
+        trace_log.dropped_total++;
+        return;
+    }
+    struct FlightEvent *records = (struct FlightEvent *)(buffer->data + sizeof(struct TraceBlockHeader));
+    if (!buffer->header.count) {
+        uint64_t now = time_us_64();
+        buffer->header.start_us = now - (uint32_t)((uint32_t)now - event->time_us);
+    }
+    records[buffer->header.count++] = *event;
+    if (buffer->header.count == TRACE_BLOCK_RECORDS) {
+        trace_buffer_close();
+    }
+}
+
+//--------------------------------------------------------------------
+// Stick access
+//--------------------------------------------------------------------
+
+static bool trace_write_done(uint8_t dev_addr, tuh_msc_complete_data_t const *cb_data) {
+    struct TraceLog *log = &trace_log;
+    uint32_t elapsed_us = time_us_32() - log->write_start_us;
+    if (elapsed_us > log->write_max_us) {
+        log->write_max_us = elapsed_us;
+    }
+    if (cb_data->csw->status == MSC_CSW_STATUS_PASSED) {
+        log->blocks_written++;
+    } else {
+        log->write_errors++;
+    }
+    uint32_t save = save_and_disable_interrupts();
+    trace_buffers[log->writing].state = TRACE_BUFFER_FREE;
+    if (trace_buffers[log->fill].state != TRACE_BUFFER_FILLING && log->active) {
+        trace_buffer_start(log->writing);
+    }
+    log->write_busy = false;
+    restore_interrupts(save);
+    return true;
+}
+
+// Hand one closed buffer to the MSC driver, oldest first
+static void trace_write_next(void) {
+    struct TraceLog *log = &trace_log;
+    if (log->write_busy || !tuh_msc_ready(log->dev_addr)) {
+        return;
+    }
+    uint8_t index = log->fill ^ 1;
+    if (trace_buffers[index].state != TRACE_BUFFER_READY) {
+        index = log->fill;
+        if (trace_buffers[index].state != TRACE_BUFFER_READY) {
+            return;
+        }
+    }
+    struct TraceBuffer *buffer = &trace_buffers[index];
+    buffer->header.seq = log->next_seq++;
+    uint32_t lba = log->data_lba + (buffer->header.seq % log->blocks) * RT_TRACE_SECTORS_PER_BLOCK;
+    buffer->state = TRACE_BUFFER_WRITING;
+    log->writing = index;
+    log->write_busy = true;
+    log->write_start_us = time_us_32();
+    if (!tuh_msc_write10(log->dev_addr, 0, buffer->data, lba, RT_TRACE_SECTORS_PER_BLOCK, trace_write_done, 0)) {
+        uint32_t save = save_and_disable_interrupts();
+        buffer->state = TRACE_BUFFER_READY;
+        log->next_seq--;
+        log->write_busy = false;
+        restore_interrupts(save);
+    }
+}
+
+//--------------------------------------------------------------------
+// FatFs disk interface, blocking.  Only used while the trace file is
+// created; the mouse path keeps being served while it waits.
+//--------------------------------------------------------------------
+
+static bool disk_io_done(uint8_t dev_addr, tuh_msc_complete_data_t const *cb_data) {
+    disk_ok = cb_data->csw->status == MSC_CSW_STATUS_PASSED;
+    disk_busy = false;
+    return true;
+}
+
+static DRESULT disk_wait(void) {
+    while (disk_busy && trace_log.dev_addr) {
+        tuh_task();
+        if (trace_service) {
+            trace_service();
+        }
+    }
+    if (!trace_log.dev_addr) {
+        return RES_NOTRDY;
+    }
+    return disk_ok ? RES_OK : RES_ERROR;
+}
+
+DSTATUS disk_status(BYTE pdrv) {
+    return trace_log.dev_addr && tuh_msc_mounted(trace_log.dev_addr) ? 0 : STA_NODISK;
+}
+
+DSTATUS disk_initialize(BYTE pdrv) {
+    return disk_status(pdrv);
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count) {
+    disk_busy = true;
+    if (!tuh_msc_read10(trace_log.dev_addr, 0, buff, sector, (uint16_t)count, disk_io_done, 0)) {
+        disk_busy = false;
+        return RES_ERROR;
+    }
+    return disk_wait();
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count) {
+    disk_busy = true;
+    if (!tuh_msc_write10(trace_log.dev_addr, 0, buff, sector, (uint16_t)count, disk_io_done, 0)) {
+        disk_busy = false;
+        return RES_ERROR;
+    }
+    return disk_wait();
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff) {
+    switch (cmd) {
+        case CTRL_SYNC:
+            return RES_OK;
+        case GET_SECTOR_COUNT:
+            *(LBA_t *)buff = tuh_msc_get_block_count(trace_log.dev_addr, 0);
+            return RES_OK;
+        case GET_SECTOR_SIZE:
+            *(WORD *)buff = (WORD)tuh_msc_get_block_size(trace_log.dev_addr, 0);
+            return RES_OK;
+        case GET_BLOCK_SIZE:
+            *(DWORD *)buff = 1;
+            return RES_OK;
+        default:
+            return RES_PARERR;
+    }
+}
+
+//--------------------------------------------------------------------
+// Trace file
+//--------------------------------------------------------------------
+
+// Next free RTnnnnnn.TRC name, one file per mount
+static uint32_t trace_next_file_number(void) {
+    uint32_t highest = 0;
+    DIR dir;
+    FILINFO info;
+    if (f_opendir(&dir, "/") != FR_OK) {
+        return 1;
+    }
+    while (f_readdir(&dir, &info) == FR_OK && info.fname[0]) {
+        unsigned long number;
+        char ext[4];
+        if (sscanf(info.fname, "RT%6lu.%3s", &number, ext) == 2 && !strcmp(ext, "TRC") && number > highest) {
+            highest = number;
+        }
+    }
+    f_closedir(&dir);
+    return highest + 1;
+}
+
+// Create and preallocate a contiguous trace file, so that data blocks
+// can be written straight to its sectors without the file system
+static bool trace_create_file(void) {
+    struct TraceLog *log = &trace_log;
+    if (tuh_msc_get_block_size(log->dev_addr, 0) != RT_TRACE_SECTOR_SIZE) {
+        printf("Trace log: sector size %lu not supported\n",
+               (unsigned long)tuh_msc_get_block_size(log->dev_addr, 0));
+        return false;
+    }
+    FRESULT res = f_mount(&trace_fs, "", 1);
+    if (res != FR_OK) {
+        printf("Trace log: no FAT file system (%d)\n", res);
+        return false;
+    }
+    DWORD free_clusters;
+    FATFS *fs;
+    if (f_getfree("", &free_clusters, &fs) != FR_OK) {
+        return false;
+    }
+    uint64_t free_bytes = (uint64_t)free_clusters * fs->csize * RT_TRACE_SECTOR_SIZE;
+    uint64_t size = (uint64_t)RT_TRACE_FILE_MB << 20;
+    if (size > free_bytes / 2) {
+        size = free_bytes / 2;
+    }
+    if (size > 0xffffffffu - TRACE_BLOCK_SIZE) {
+        size = 0xffffffffu - TRACE_BLOCK_SIZE;    // FAT file size limit
+    }
+    size -= size % TRACE_BLOCK_SIZE;
+    if (size < ((uint64_t)RT_TRACE_MIN_FILE_MB << 20)) {
+        printf("Trace log: stick full\n");
+        return false;
+    }
+
+    uint32_t number = trace_next_file_number();
+    snprintf(log->file_name, sizeof(log->file_name), "RT%06lu.TRC", (unsigned long)number);
+    FIL file;
+    if (f_open(&file, log->file_name, FA_CREATE_NEW | FA_WRITE) != FR_OK) {
+        return false;
+    }
+    // Free space is often fragmented, retry smaller until it fits in
+    // one contiguous run of clusters
+    while ((res = f_expand(&file, size, 1)) == FR_DENIED && size / 2 >= ((uint64_t)RT_TRACE_MIN_FILE_MB << 20)) {
+        size /= 2;
+        size -= size % TRACE_BLOCK_SIZE;
+    }
+    if (res != FR_OK) {
+        f_close(&file);
+        f_unlink(log->file_name);
+        printf("Trace log: cannot allocate %s (%d)\n", log->file_name, res);
+        return false;
+    }
+
+    log->session = (uint32_t)time_us_64() ^ (number << 16);
+    log->blocks = (uint32_t)(size / TRACE_BLOCK_SIZE) - 1;
+    log->data_lba = (uint32_t)(fs->database + (LBA_t)(file.obj.sclust - 2) * fs->csize) + RT_TRACE_SECTORS_PER_BLOCK;
+    log->next_seq = 0;
+
+    // Header block, staged in a buffer that is not in use yet
+    struct TraceBuffer *buffer = &trace_buffers[0];
+    memset(buffer->data, 0, sizeof(buffer->data));
+    struct TraceFileHeader *header = (struct TraceFileHeader *)buffer->data;
+    memcpy(header->magic, TRACE_FILE_MAGIC, sizeof(header->magic));
+    header->version = TRACE_FILE_VERSION;
+    header->block_size = TRACE_BLOCK_SIZE;
+    header->blocks = log->blocks;
+    header->session = log->session;
+    header->block_header_size = sizeof(struct TraceBlockHeader);
+    header->record_size = sizeof(struct FlightEvent);
+    UINT written;
+    res = f_write(&file, buffer->data, sizeof(buffer->data), &written);
+    f_close(&file);
+    if (res != FR_OK || written != sizeof(buffer->data)) {
+        printf("Trace log: cannot write %s (%d)\n", log->file_name, res);
+        return false;
+    }
+    printf("Trace log: %s, %lu MB, %lu blocks\n", log->file_name, (unsigned long)(size >> 20),
+           (unsigned long)log->blocks);
+    return true;
+}
+
+static void trace_start(void) {
+    uint32_t save = save_and_disable_interrupts();
+    trace_buffers[0].state = TRACE_BUFFER_FREE;
+    trace_buffers[1].state = TRACE_BUFFER_FREE;
+    trace_log.dropped = 0;
+    trace_buffer_start(0);
+    trace_log.active = true;
+    restore_interrupts(save);
+}
+
+void trace_log_poll(void) {
+    struct TraceLog *log = &trace_log;
+    if (!log->dev_addr) {
+        return;
+    }
+    if (!log->active) {
+        if (log->enabled && !log->failed && !log->write_busy && tuh_msc_ready(log->dev_addr)) {
+            if (trace_create_file()) {
+                trace_start();
+            } else {
+                log->failed = true;
+            }
+        }
+        if (!log->active) {
+            return;
+        }
+    }
+    // Flush a partial block that has waited long enough, as soon as the
+    // other buffer can take over
+    uint32_t save = save_and_disable_interrupts();
+    struct TraceBuffer *buffer = &trace_buffers[log->fill];
+    if (buffer->state == TRACE_BUFFER_FILLING && buffer->header.count &&
+        time_us_64() - buffer->header.start_us > RT_TRACE_FLUSH_US &&
+        trace_buffers[log->fill ^ 1].state == TRACE_BUFFER_FREE) {
+        trace_buffer_close();
+        log->partial_blocks++;
+    }
+    restore_interrupts(save);
+    trace_write_next();
+}
+
+void trace_log_enable(bool enabled) {
+    struct TraceLog *log = &trace_log;
+    log->enabled = enabled;
+    if (!enabled && log->active) {
+        // What is staged is lost, a new file is started when enabled again
+        log->active = false;
+        printf("Trace log: %s closed\n", log->file_name);
+    }
+    log->failed = false;
+}
+
+bool trace_log_enabled(void) {
+    return trace_log.enabled;
+}
+
+void trace_log_print_stats(void) {
+    const struct TraceLog *log = &trace_log;
+    if (!log->dev_addr) {
+        printf("Trace log: %s, no stick\n", log->enabled ? "on" : "off");
+        return;
+    }
+    printf("Trace log: %s, %s, %lu blocks written (%lu partial), %lu write errors, "
+           "%lu events dropped, longest write %lu us\n",
+           log->active ? log->file_name : "no file", log->enabled ? "on" : "off",
+           (unsigned long)log->blocks_written, (unsigned long)log->partial_blocks,
+           (unsigned long)log->write_errors, (unsigned long)log->dropped_total,
+           (unsigned long)log->write_max_us);
+}
+
+// TinyUSB callback: mass storage device mounted.  The file is created
+// from the main loop, not from within the USB stack.
+void tuh_msc_mount_cb(uint8_t dev_addr) {
+    if (trace_log.dev_addr) {
+        printf("Mass storage ignored: dev_addr=%d, trace log already on dev_addr=%d\n",
+               dev_addr, trace_log.dev_addr);
+        return;
+    }
+    trace_log.dev_addr = dev_addr;
+    trace_log.failed = false;
+    printf("Mass storage detected: dev_addr=%d\n", dev_addr);
+}
+
+// TinyUSB callback: mass storage device unmounted.  A write in flight
+// never completes.
+void tuh_msc_umount_cb(uint8_t dev_addr) {
+    if (dev_addr != trace_log.dev_addr) {
+        return;
+    }
+    uint32_t save = save_and_disable_interrupts();
+    trace_log.active = false;
+    trace_log.dev_addr = 0;
+    trace_log.write_busy = false;
+    restore_interrupts(save);
+    disk_busy = false;
+    f_mount(NULL, "", 0);
+    printf("Mass storage disconnected: dev_addr=%d\n", dev_addr);
+}
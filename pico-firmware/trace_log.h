@@ -0,0 +1,29 @@
+#ifndef TRACE_LOG_H
+#define TRACE_LOG_H
+
+// Continuous trace of flight recorder events to a FAT-formatted USB
+// stick, see trace_file.h for the format
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "flight_recorder.h"
+
+// Work the main loop must keep doing while a file system call waits for
+// the stick, at mount time only
+void trace_log_init(void (*service)(void));
+
+// Queue an event, called by fr_record with interrupts disabled.  Never
+// waits: when both staging buffers are busy the event is dropped and
+// counted.
+void trace_log_record(const struct FlightEvent *event);
+
+// Create the trace file after a stick was mounted, write full staging
+// buffers and flush a partial one that has waited too long
+void trace_log_poll(void);
+
+void trace_log_enable(bool enabled);
+bool trace_log_enabled(void);
+void trace_log_print_stats(void);
+
+#endif // TRACE_LOG_H
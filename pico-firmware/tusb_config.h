@@ -101,7 +101,7 @@
 // Size of buffer to hold descriptors and other data used for enumeration
 #define CFG_TUH_ENUMERATION_BUFSIZE 256
 
-#define CFG_TUH_HUB                 1 // number of supported hubs
+#define CFG_TUH_HUB                 2 // number of supported hubs, 7-port hubs are two 4-port hubs chained
 #define CFG_TUH_CDC                 1 // CDC ACM
 #define CFG_TUH_CDC_FTDI            1 // FTDI Serial.  FTDI is not part of CDC class, only to re-use CDC driver API
 #define CFG_TUH_CDC_CP210X          1 // CP210x Serial. CP210X is not part of CDC class, only to re-use CDC driver API
@@ -110,8 +110,11 @@
 #define CFG_TUH_MSC                 1
 #define CFG_TUH_VENDOR              0
 
-// max device support (excluding hub device): 1 hub typically has 4 ports
-#define CFG_TUH_DEVICE_MAX          (3*CFG_TUH_HUB + 1)
+// max device support (excluding hub devices): MAX_USB_MICE pointing
+// devices in pico-rt-mouse.c, plus the telemetry adapter and the trace
+// stick.  The RP2040 polls at most 15 interrupt endpoints across all of
+// them, one per HID interface and hub and one for the adapter.
+#define CFG_TUH_DEVICE_MAX          (8 + 2)
 
 //------------- HID -------------//
 #define CFG_TUH_HID_EPIN_BUFSIZE    64
@@ -124,8 +127,13 @@
 #define CFG_TUH_CDC_LINE_CONTROL_ON_ENUM    0x03
 
 // Set Line Coding on enumeration/mounted, value for cdc_line_coding_t
-// bit rate = 115200, 1 stop bit, no parity, 8 bit data width
-#define CFG_TUH_CDC_LINE_CODING_ON_ENUM   { 115200, CDC_LINE_CODING_STOP_BITS_1, CDC_LINE_CODING_PARITY_NONE, 8 }
+// bit rate = 2000000, 1 stop bit, no parity, 8 bit data width.  The
+// adapter carries the telemetry stream; FT232R, CH340 and CP2102N
+// support this rate, older CP2102 stop at 921600.
+#define CFG_TUH_CDC_LINE_CODING_ON_ENUM   { 2000000, CDC_LINE_CODING_STOP_BITS_1, CDC_LINE_CODING_PARITY_NONE, 8 }
+
+// Transmit FIFO, several milliseconds of telemetry at 2 Mbaud
+#define CFG_TUH_CDC_TX_BUFSIZE      1024
 
 
 #ifdef __cplusplus